@@ -17,21 +17,23 @@
  * along with qhashpw.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <cstring>
+
 #include "account.h"
 #include "hashpw.h"
 
 const int Account::INVALID_INT_FIELD = -1;
 
 Account::Account()
-: algo_(HASH_RIPEMD160), flags_(INVALID_INT_FIELD), min_(INVALID_INT_FIELD),
-max_(INVALID_INT_FIELD), num_(INVALID_INT_FIELD)
+: algo_(INVALID_INT_FIELD), flags_(INVALID_INT_FIELD), min_(INVALID_INT_FIELD),
+max_(INVALID_INT_FIELD), num_(INVALID_INT_FIELD), scheme_(INVALID_INT_FIELD)
 {
 }
 
 Account::Account(const Account &a)
 : QObject(), category_(a.category()), site_(a.site()), user_(a.user()),
   note_(a.note()), salt_(a.salt()), algo_(a.algo()), flags_(a.flags()),
-  min_(a.min()), max_(a.max()), num_(a.num())
+  min_(a.min()), max_(a.max()), num_(a.num()), scheme_(a.scheme())
 {
 }
 
@@ -40,31 +42,103 @@ Account Account::operator=(const Account &a)
     return Account(a);
 }
 
-bool Account::readFrom(Tokenizer *t, const DefaultAccount *def)
+static const char *const UNKNOWN_FLAG = QT_TRANSLATE_NOOP("Account", "I don't understand the flag description \"%1\"");
+static const char *const UNKNOWN_ALGO = QT_TRANSLATE_NOOP("Account", "Invalid algorithm description \"%1\"");
+static const char *const UNKNOWN_SCHEME = QT_TRANSLATE_NOOP("Account", "Invalid scheme description \"%1\"");
+
+const Account::FieldName Account::flagNames_[] =
+{
+    {"print", FLAGS_PRINT},
+    {"alpha", FLAGS_ALPHA},
+    {"alnum", FLAGS_ALNUM},
+    {"lower", FLAGS_LOWER},
+    {0, 0}
+};
+
+const Account::FieldName Account::algoNames_[] =
+{
+    {"ripemd160", HASH_RIPEMD160},
+    {"sha1", HASH_SHA1},
+    {"dss1", HASH_DSS1},
+    {"md5", HASH_MD5},
+    {"sha256", HASH_SHA256},
+    {"sha512", HASH_SHA512},
+    {"blake2b", HASH_BLAKE2B},
+    {0, 0}
+};
+
+const Account::FieldName Account::schemeNames_[] =
 {
-    int version = (def == 0)?INVALID_INT_FIELD:def->version();
+    {"reject", SCHEME_REJECT},
+    {"unbiased", SCHEME_UNBIASED},
+    {"stream", SCHEME_STREAM},
+    {0, 0}
+};
+
+// version and author belong to the DefaultAccount, so they are only
+// accessed through objects of that class (DEFONLY)
+const Account::Field Account::fields_[] =
+{
+    {"version", 2 | DEFONLY, false, 0,
+     static_cast<int Account::*>(&DefaultAccount::version_), 0, 0},
+    {"author", 2 | DEFONLY, false,
+     static_cast<QString Account::*>(&DefaultAccount::author_), 0, 0, 0},
+    {"site", 1, true, &Account::site_, 0, 0, 0},
+    {"user", 1, true, &Account::user_, 0, 0, 0},
+    {"category", 2, false, &Account::category_, 0, 0, 0},
+    {"note", 1, false, &Account::note_, 0, 0, 0},
+    {"flag", 1, true, 0, &Account::flags_, flagNames_, UNKNOWN_FLAG},
+    {"min", 1, true, 0, &Account::min_, 0, 0},
+    {"max", 1, true, 0, &Account::max_, 0, 0},
+    {"num", 1, true, 0, &Account::num_, 0, 0},
+    {"algo", 2, true, 0, &Account::algo_, algoNames_, UNKNOWN_ALGO},
+    {"salt", 2, true, &Account::salt_, 0, 0, 0},
+    {"scheme", 3, true, 0, &Account::scheme_, schemeNames_, UNKNOWN_SCHEME},
+    {0, 0, false, 0, 0, 0, 0}
+};
+
+const Account::Field *Account::fieldSlots_[Account::FIELD_SLOTS];
+
+// fields_ is a constant, so it is ready before any dynamic initialization
+const bool Account::fieldSlotsBuilt_ = Account::buildFieldSlots();
+
+bool Account::buildFieldSlots()
+{
+    for(const Field *f = fields_; f->key; ++f)
+    {
+        int h = fieldHash(f->key, qstrlen(f->key));
+        Q_ASSERT_X(fieldSlots_[h] == 0, "Account::buildFieldSlots",
+                   "fieldHash is not perfect for the keys of fields_ anymore");
+        fieldSlots_[h] = f;
+    }
+    return true;
+}
 
-    // internal flag that enforces that an option
-    // can only occur in the default account
-    static const int DEFONLY = 0x80;
-    static const int VERSIONMASK = 0x7F;
+const Account::Field *Account::findField(const char *key, int len)
+{
+    if(len <= 0) return 0;
 
-    // version identifies the minimum verison
-    struct {const QString key; QString *sval; int *ival; int version;} var[] =
-    {
-       {"category", &category_, NULL, 2},
-        {"site", &site_, NULL, 1},
-        {"user", &user_, NULL, 1},
-        {"note", &note_, NULL, 1},
-        {"salt", &salt_, NULL, 2},
-        {"flag", reinterpret_cast<QString*>(&flags_), &flags_, 1},
-        {"algo", reinterpret_cast<QString*>(&algo_), &algo_, 2},
-        {"min", NULL, &min_, 1},
-        {"max", NULL, &max_, 1},
-        {"num", NULL, &num_, 1},
-        {"version", NULL, &version, 2 | DEFONLY},
-        {"", NULL, NULL, INVALID_INT_FIELD}
-    };
+    const Field *f = fieldSlots_[fieldHash(key, len)];
+    if(f == 0 || (int)qstrlen(f->key) != len || memcmp(f->key, key, len) != 0)
+        return 0;
+    return f;
+}
+
+const char *Account::fieldName(const Field *f, int value)
+{
+    for(const FieldName *n = f->names; n && n->name; ++n)
+        if(n->value == value) return n->name;
+    return 0;
+}
+
+bool Account::readFrom(Tokenizer *t, const DefaultAccount *def)
+{
+    // longest key or name of a value, and then some
+    char buf[16];
+
+    // the fields that were assigned so far (by index in fields_)
+    unsigned assigned = 0;
+    bool isString;
 
     if(t->error() == Tokenizer::EOF_ERROR) return false;
 
@@ -77,12 +151,18 @@ bool Account::readFrom(Tokenizer *t, const DefaultAccount *def)
         return false;
     }
 
-    QString key;
-
     while(!(t->tokT() == Tokenizer::TT_CHAR && t->tok.c == '}'))
     {
-        key = *t->tok.s;
-        Q_ASSERT(!key.isNull());
+        // Look the key up on the token itself, only an
+        // unknown key is converted (for the warning)
+        const Field *f = findField(buf, t->tokCopy(buf, sizeof(buf)));
+        QString unknownKey;
+
+        if(f == 0)
+        {
+            unknownKey = t->tokString();
+            Q_ASSERT(!unknownKey.isNull());
+        }
 
         t->next();
 
@@ -96,86 +176,70 @@ bool Account::readFrom(Tokenizer *t, const DefaultAccount *def)
         }
 
         // Now we have either a TT_NUMBER, or a TT_STRING
-        // Search our list of fields to find out what type it SHOULD be
-
-        int i;
+        // The field found above tells what type it SHOULD be
 
-        for(i = 0; var[i].key != "" && var[i].key != key; ++i);
-
-        if(var[i].key == "")
+        if(f == 0)
         {
-            raiseWarning(t, tr("Unknown field \"%1\" - ignored!").arg(key));
+            raiseWarning(t, tr("Unknown field \"%1\" - ignored!").arg(unknownKey));
             goto endOfAssignment;
         }
 
         // We have an assignment to a known key (variable)
         // First determine if it is valid here
-        if(var[i].version & DEFONLY)
+        if(f->version & DEFONLY)
         {
             if(def != 0)
             {
-                raiseWarning(t, tr("Field \"%1\" not allowed here - ignored!").arg(var[i].key));
+                raiseWarning(t, tr("Field \"%1\" not allowed here - ignored!").arg(f->key));
                 goto endOfAssignment;
             }
 
         }
         else
         {
-            if(def != 0 && (var[i].version & VERSIONMASK) > def->version())
+            if(def != 0 && (f->version & VERSIONMASK) > def->version())
             {
-                raiseError(t, tr("Field \"%1\" not supported in this version").arg(var[i].key));
+                raiseError(t, tr("Field \"%1\" not supported in this version").arg(f->key));
                 goto endOfAssignment;
             }
         }
 
         // Okay, the assignment is valid
-        if(t->tokT() == Tokenizer::TT_STRING && var[i].sval)
+        isString = t->tokT() == Tokenizer::TT_STRING;
+        if(isString ? (f->str == 0 && f->names == 0) : f->num == 0)
         {
-            // String assignment
-            if(key == "flag")
-            {
-                if(flags_ != INVALID_INT_FIELD)
-                    goto errorDoubleAssign;
-                else
-                    if(!doFlagAssignment(t, *t->tok.s))
-                        return false;
-            }
-            else if(key == "algo")
-            {
-                if(flags_ != INVALID_INT_FIELD)
-                    goto errorDoubleAssign;
-                else
-                    if(!doAlgoAssignment(t, *t->tok.s))
-                        return false;
-            }
-            else
-            {
-                if(!var[i].sval->isNull())
-                    goto errorDoubleAssign;
-                else
-                    *var[i].sval = *t->tok.s;
-            }
+            raiseError(t, tr("Wrong datatype for field %1").arg(f->key));
+            goto endOfAssignment;
+        }
 
+        if(assigned & (1u << (f - fields_)))
+        {
+            raiseError(t, tr("Component %1 was already set for account %2")
+                       .arg(f->key)
+                       .arg(site_.isNull()?tr("<unnamed account>"):site_));
+            return false;
         }
-        else if(t->tokT() == Tokenizer::TT_NUMBER && var[i].ival)
+
+        if(isString && f->str)
+            this->*f->str = t->tokString();
+        else if(isString)
         {
-            // number assignment
-            if(*var[i].ival != INVALID_INT_FIELD)
+            // a number given by name
+            const FieldName *n = 0;
+            if(t->tokCopy(buf, sizeof(buf)) >= 0)
+                for(n = f->names; n->name && qstrcmp(n->name, buf) != 0; ++n);
+
+            if(n == 0 || n->name == 0)
             {
-                errorDoubleAssign:
-                raiseError(t, tr("Component %1 was already set for account %2")
-                           .arg(key)
-                           .arg(site_.isNull()?tr("<unnamed account>"):site_));
+                raiseError(t, tr(f->badName).arg(t->tokString()));
                 return false;
             }
-            *var[i].ival = t->tok.i;
-            if(key == "version")
-            {
-                Q_ASSERT(def == 0);
-                dynamic_cast<DefaultAccount*>(this)->version_ = version;
-            }
+            this->*f->num = n->value;
         }
-        else raiseError(t, tr("Wrong datatype for field %1").arg(key));
+        else
+            this->*f->num = t->tok.i;
+
+        assigned |= 1u << (f - fields_);
 
 endOfAssignment:
         t->next();
@@ -193,54 +257,21 @@ endOfAssignment:
 
 void Account::fillAccount(const Account &defaultAccount)
 {
-    if(user_.isNull()) user_ = defaultAccount.user();
-    if(site_.isNull()) site_ = defaultAccount.site();
-    // Do not inherit note
-    if(salt_.isNull()) salt_ = defaultAccount.salt();
-    if(algo_ == INVALID_INT_FIELD) algo_ = defaultAccount.algo();
-    if(flags_ == INVALID_INT_FIELD) flags_ = defaultAccount.flags();
-    if(min_ == INVALID_INT_FIELD) min_ = defaultAccount.min();
-    if(max_ == INVALID_INT_FIELD) max_ = defaultAccount.max();
-    if(num_ == INVALID_INT_FIELD) num_ = defaultAccount.num();
-}
-
-bool Account::doAlgoAssignment(const Tokenizer *t, const QString &val)
-{
-    if(val == "ripemd160")
-        algo_ = HASH_RIPEMD160;
-    else if(val == "sha1")
-        algo_ = HASH_SHA1;
-    else if(val == "dss1")
-        algo_ = HASH_DSS1;
-    else if(val == "md5")
-        algo_ = HASH_MD5;
-    else
+    // Do not inherit note and category, see fields_
+    for(const Field *f = fields_; f->key; ++f)
     {
-        raiseError(t, tr("Invalid algorithm description \"%1\"")
-                   .arg(val));
-        return false;
-    }
-    return true;
+        if(!f->inherit) continue;
 
-}
-
-bool Account::doFlagAssignment(const Tokenizer *t, const QString &val)
-{
-    if(val == "print")
-        flags_ = FLAGS_PRINT;
-    else if(val == "alpha")
-        flags_ = FLAGS_ALPHA;
-    else if(val == "alnum")
-        flags_ = FLAGS_ALNUM;
-    else if(val == "lower")
-        flags_ = FLAGS_LOWER;
-    else
-    {
-        raiseError(t, tr("I don't understand the flag description \"%1\"")
-                   .arg(val));
-        return false;
+        if(f->str)
+        {
+            if((this->*f->str).isNull()) this->*f->str = defaultAccount.*f->str;
+        }
+        else if(this->*f->num == INVALID_INT_FIELD)
+            this->*f->num = defaultAccount.*f->num;
     }
-    return true;
+
+    // the algorithm of version 1 files, which had no choice
+    if(algo_ == INVALID_INT_FIELD) algo_ = HASH_RIPEMD160;
 }
 
 bool Account::forceChar(Tokenizer *t, char c, const QString &errorMsg, bool commentIsToken)
@@ -316,51 +347,26 @@ void AccountSaver::exec()
 {
     const DefaultAccount *def = qobject_cast<const DefaultAccount*>(a);
 
-    QString v;
-
     out << "{\n";
 
-    if(def && version == 2)
-    {
-        QString s = QString(
-                "\tversion = \"%1\",\n"
-                "\tauthor = \"%2\"")
-               .arg(def->version())
-               .arg(def->author());
-        firstAssignment = false;
-        out << s;
-    }
-
-    writeString(1, "site", a->site());
-    writeString(1, "user", a->user());
-    writeString(2, "category", a->category());
-    writeString(1, "note", a->note());
-
-    v.clear();
-    switch(a->flags())
+    for(const Account::Field *f = Account::fields_; f->key; ++f)
     {
-        case FLAGS_PRINT: v = "print"; break;
-        case FLAGS_ALPHA: v = "alpha"; break;
-        case FLAGS_ALNUM: v = "alnum"; break;
-        case FLAGS_LOWER: v = "lower"; break;
-    }
-    writeString(1, "flag", v);
+        if((f->version & Account::DEFONLY) && !def) continue;
 
-    writeNumber(1, "min", a->min());
-    writeNumber(1, "max", a->max());
-    writeNumber(1, "num", a->num());
+        int ver = f->version & Account::VERSIONMASK;
 
-    v.clear();
-    switch(a->algo())
-    {
-        case HASH_RIPEMD160: v = "ripemd160"; break;
-        case HASH_SHA1:      v = "sha1"; break;
-        case HASH_DSS1:      v = "dss1"; break;
-        case HASH_MD5:       v = "md5"; break;
+        if(f->str)
+            writeString(ver, f->key, a->*f->str);
+        else
+        {
+            // by name if it has one
+            const char *name = Account::fieldName(f, a->*f->num);
+            if(name)
+                writeString(ver, f->key, name);
+            else
+                writeNumber(ver, f->key, a->*f->num);
+        }
     }
-    writeString(2, "algo", v);
-
-    writeString(2, "salt", a->salt());
 
     out << "\n}\n";
 }
@@ -32,6 +32,8 @@ class Account : public QObject
 {
     Q_OBJECT
 
+    friend class AccountSaver;
+
 public:
     // Special value to show that a field has not been set
     static const int INVALID_INT_FIELD;
@@ -55,6 +57,7 @@ public:
 
     // For every field that is set in default, but
     // not in this, copy the value from default
+    // (an algorithm set in neither is HASH_RIPEMD160)
     void fillAccount(const Account &defaultAccount);
 
     void saveTo(QTextStream &f, int version) const;
@@ -69,6 +72,10 @@ public:
     inline int min() const { return min_; }
     inline int max() const { return max_; }
     inline int num() const { return num_; }
+    inline int scheme() const { return scheme_; }
+
+    void setCategory(const QString &c)
+    { category_ = c; }
 
     inline QString errorMsg()
     {
@@ -78,8 +85,49 @@ public:
     }
 
 protected:
-    bool doAlgoAssignment(const Tokenizer *t, const QString &val);
-    bool doFlagAssignment(const Tokenizer *t, const QString &val);
+    // Symbolic value of a number field
+    struct FieldName
+    {
+        const char *name;
+        int value;
+    };
+
+    // A field of the file format. The table fields_ (see account.cpp)
+    // drives readFrom, fillAccount and AccountSaver, so a field is
+    // added by adding its line there.
+    struct Field
+    {
+        const char *key;
+        int version;            // first version with the field, maybe | DEFONLY
+        bool inherit;           // copied from the default account by fillAccount
+        QString Account::*str;  // either a string field
+        int Account::*num;      // or a number field,
+        const FieldName *names; // which may also be given by one of these names
+        const char *badName;    // error message for a name that is not one of them
+    };
+
+    // the field may only occur in the default account
+    static const int DEFONLY = 0x80;
+    static const int VERSIONMASK = 0x7F;
+
+    // in the order they are saved, terminated by a 0 key
+    static const Field fields_[];
+    static const FieldName flagNames_[], algoNames_[], schemeNames_[];
+
+    // fields_ by a perfect hash of the key (checked when it is built)
+    static const int FIELD_SLOTS = 32;
+    static const Field *fieldSlots_[FIELD_SLOTS];
+    static const bool fieldSlotsBuilt_;
+
+    static bool buildFieldSlots();
+    static inline int fieldHash(const char *key, int len)
+    { return (len + 5*(uchar)key[0] + (uchar)key[len-1]) & (FIELD_SLOTS-1); }
+
+    // The field with the key of len bytes or 0
+    static const Field *findField(const char *key, int len);
+
+    // The name of value for a field with names or 0
+    static const char *fieldName(const Field *f, int value);
 
     // If current token is the character c, advance to the next token
     // (is commentIsToken, then that next token might be a comment)
@@ -90,7 +138,7 @@ protected:
     void raiseWarning(const Tokenizer *t, const QString &msg);
 
     QString category_, site_, user_, note_, salt_;
-    int algo_, flags_, min_, max_, num_;
+    int algo_, flags_, min_, max_, num_, scheme_;
 
     QString errorMsg_;
 };
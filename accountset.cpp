@@ -17,7 +17,42 @@
  * along with qhashpw.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <QtCore/QFuture>
+#include <QtCore/QThread>
+
 #include "accountset.h"
+#include "taskscheduler.h"
+
+// Smallest part of a file that is read by a thread of its own
+#define MIN_PIECE_SIZE  (64*1024)
+
+struct AccountSet::Piece
+{
+    Piece(const DefaultAccount &d) : def(d), headerAt(-1), noError(true) {}
+
+    DefaultAccount def;         // with the category of the last header
+    QList<Account> accounts;
+    QString errorMsg;
+
+    // (v1) number of accounts before the first category header, whose
+    // category is only known when the pieces before were read; -1 if
+    // there is no header
+    int headerAt;
+    bool noError;
+};
+
+class AccountSet::ReadTask : public ScheduledTask
+{
+public:
+    ReadTask(Tokenizer *t, Piece *piece) : t_(t), piece_(piece) {}
+
+protected:
+    void run() { readAccounts(t_, piece_); }
+
+private:
+    Tokenizer *t_;              // readFrom waits for the task
+    Piece *piece_;
+};
 
 AccountSet::AccountSet()
 {
@@ -44,35 +79,111 @@ void AccountSet::filter(const QString &searchPhrase)
     emit filterChanged();
 }
 
-bool AccountSet::readFrom(Tokenizer *t)
+void AccountSet::readAccounts(Tokenizer *t, Piece *piece)
 {
-    QString s;
-
-    all_.clear();
-
-    bool noError = defaultAccount_.readFrom(t, 0);
-
-    s += defaultAccount_.errorMsg();
-
-    while(noError)
+    while(piece->noError)
     {
         if(t->tokT() == Tokenizer::TT_COMMENT)
         {
-            QString s(*t->tok.s);
+            QString s(t->tokString());
             t->next();
-            if(defaultAccount_.version() == 1 &&
+            if(piece->def.version() == 1 &&
                s.startsWith("##"))
             {
                 s = s.remove('#').trimmed().toLower();
                 s[0] = s[0].toUpper();
-                defaultAccount_.setCurrentCategory(s);
+                piece->def.setCurrentCategory(s);
+                if(piece->headerAt == -1) piece->headerAt = piece->accounts.count();
             }
         }
         Account a;
         if(t->error() == Tokenizer::EOF_ERROR) break;
-        noError = a.readFrom(t, &defaultAccount_);
-        s += a.errorMsg();
-        all_.append(a);
+        piece->noError = a.readFrom(t, &piece->def);
+        piece->errorMsg += a.errorMsg();
+        piece->accounts.append(a);
+    }
+}
+
+bool AccountSet::readFrom(Tokenizer *t)
+{
+    QString s;
+
+    all_.clear();
+
+    bool noError = defaultAccount_.readFrom(t, 0);
+
+    s += defaultAccount_.errorMsg();
+
+    // Large files are cut into pieces, which are read at the same time,
+    // the calling thread reads the first one. It waits for the others,
+    // so it must not be a worker itself. A file of less than one piece
+    // is not even scanned for a place to cut.
+    QList<Tokenizer *> tokenizers;
+    if(noError && t->bytesLeft() >= MIN_PIECE_SIZE)
+    {
+        Q_ASSERT_X(!TaskScheduler::instance()->isWorker(), "AccountSet::readFrom",
+                   "called in a worker of the TaskScheduler");
+
+        int pieceSize = t->bytesLeft() / (4*qMax(1, QThread::idealThreadCount()));
+        tokenizers = t->split(qMax(pieceSize, MIN_PIECE_SIZE));
+    }
+    tokenizers.prepend(t);
+
+    // The category at the start of a piece is not known yet
+    DefaultAccount def(defaultAccount_);
+    def.setCurrentCategory(QString());
+
+    QList<Piece *> pieces;
+    QList<QFuture<void> > running;
+    for(int i = 0; i < tokenizers.count(); ++i)
+    {
+        pieces.append(new Piece(def));
+        if(i == 0) continue;
+
+        ReadTask *task = new ReadTask(tokenizers[i], pieces[i]);
+        running.append(task->future());
+        TaskScheduler::instance()->submit(task, TaskScheduler::Interactive);
+    }
+
+    pieces[0]->noError = noError;
+    readAccounts(t, pieces[0]);
+
+    foreach(QFuture<void> f, running)
+        f.waitForFinished();
+
+    // Put the pieces together in file order, up to the first
+    // account that could not be read
+    QString category = defaultAccount_.currentCategory();
+    for(int i = 0; i < pieces.count() && noError; ++i)
+    {
+        Piece *piece = pieces[i];
+
+        for(int j = 0; j < piece->accounts.count(); ++j)
+        {
+            // like Account::readFrom would have done, if the
+            // account was read to the end
+            bool read = piece->noError || j < piece->accounts.count()-1;
+            if(read && (piece->headerAt == -1 || j < piece->headerAt) &&
+               defaultAccount_.version() == 1 && piece->accounts[j].category().isEmpty())
+                piece->accounts[j].setCategory(category);
+        }
+
+        if(i == 0)
+            all_ = piece->accounts;
+        else
+            all_ += piece->accounts;
+
+        if(piece->headerAt != -1) category = piece->def.currentCategory();
+        s += piece->errorMsg;
+        noError = piece->noError;
+    }
+
+    defaultAccount_.setCurrentCategory(category);
+
+    for(int i = 0; i < pieces.count(); ++i)
+    {
+        if(i > 0) delete tokenizers[i];
+        delete pieces[i];
     }
 
     errorMsg_ = s;
@@ -44,6 +44,13 @@ public:
         return at(i);
     }
 
+    // The same account as it was read, without the fields of the
+    // default account (cheap, at() resolves it)
+    const Account &unresolved(int i) const
+    {
+        return *filtered_[i];
+    }
+
     const DefaultAccount defaultAccount() const
     {
         return defaultAccount_;
@@ -58,6 +65,9 @@ public:
 
     void filter(const QString &searchPhrase);
 
+    // Large files are read by the workers of the TaskScheduler and
+    // this waits for them, so it must not be called in one of them
+    // (asserted in debug builds, it could deadlock)
     bool readFrom(Tokenizer *t);
 
     int rowCount() const;
@@ -65,6 +75,13 @@ public:
     void saveTo(QTextStream &f);
 
 private:
+    // A part of the file, read on its own (see readFrom)
+    struct Piece;
+    class ReadTask;
+    friend class ReadTask;
+
+    static void readAccounts(Tokenizer *t, Piece *piece);
+
     DefaultAccount defaultAccount_;
 
     QList<Account> all_;
@@ -19,6 +19,7 @@
 
 #include <QtCore/QHash>
 #include <QtCore/QTimer>
+#include <QtCore/QVector>
 #include <QtGui/QApplication>
 #include <QtGui/QBoxLayout>
 #include <QtGui/QClipboard>
@@ -33,9 +34,15 @@
 
 #include "accountsetview.h"
 #include "hashpw.h"
+#include "passwordcache.h"
+#include "passwordservice.h"
+#include "secmem.h"
 
 AccountSetView::AccountSetView(AccountSet *as, const QString &filename)
-    : QStackedWidget(), accounts_(as), filename_(filename), isLocked_(true)
+    : QStackedWidget(), accounts_(as), filename_(filename), isLocked_(true), key_(0),
+      service_(new PasswordService(this)), hoverRequest_(0), hoverRow_(-1),
+      detailRequest_(0), detailRow_(-1), copyRequest_(0),
+      cache_(new PasswordCache), warmUpTimer_(new QTimer(this))
 {
     // Table/List view
     listView = new QTableWidget(as->rowCount(),4);
@@ -65,10 +72,16 @@ AccountSetView::AccountSetView(AccountSet *as, const QString &filename)
     connect(tree, SIGNAL(currentItemChanged(QTreeWidgetItem*,QTreeWidgetItem*)),
                   SLOT(currentItemChanged(QTreeWidgetItem*,QTreeWidgetItem*)));
     connect(detailInfoShow, SIGNAL(clicked()), SLOT(detailInfoShowClicked()));
+    connect(service_, SIGNAL(ready(int,QString)), SLOT(passwordReady(int,QString)));
+    connect(service_, SIGNAL(failed(int,int)), SLOT(passwordFailed(int,int)));
 
     connect(accounts_, SIGNAL(filterChanged()), SLOT(updateTable()));
     connect(accounts_, SIGNAL(filterChanged()), SLOT(updateTree()));
 
+    warmUpTimer_->setSingleShot(true);
+    warmUpTimer_->setInterval(300);
+    connect(warmUpTimer_, SIGNAL(timeout()), SLOT(warmUpCache()));
+
     filter("");
 
     setCurrentWidget(treeView);
@@ -76,6 +89,9 @@ AccountSetView::AccountSetView(AccountSet *as, const QString &filename)
 
 AccountSetView::~AccountSetView()
 {
+    service_->setKey(0);    // waits until no thread uses key_
+    delete cache_;          // the same
+    hashpw_key_free(key_);
     delete accounts_;
 }
 
@@ -97,15 +113,13 @@ QString AccountSetView::blindedPassword(const Account &a) const
     return s;
 }
 
-void AccountSetView::copyCurrentPassword() const
+void AccountSetView::copyCurrentPassword()
 {
-    QTableWidget *t = const_cast<QTableWidget*>(listView);
-
     // At most one row, which is columnCount() cells,
     // can be selected
-    Q_ASSERT(t->selectedItems().size() <= t->columnCount());
+    Q_ASSERT(listView->selectedItems().size() <= listView->columnCount());
 
-    if(t->selectedItems().size() == 0)
+    if(listView->selectedItems().size() == 0)
         QMessageBox(
                 QMessageBox::Critical,
                 tr("Nothing selected"),
@@ -114,29 +128,65 @@ void AccountSetView::copyCurrentPassword() const
                 ).exec();
     else
     {
-        // Unfortunately selectedItems is not const, so we need to hack a bit here
-        const QTableWidgetItem *w = t->selectedItems()[0];
+        const QTableWidgetItem *w = listView->selectedItems()[0];
         Account a = accounts_->at(listView->row(w));
-        QApplication::clipboard()->setText(getPassword(a));
-        QMessageBox(QMessageBox::Information,
-                    tr("Success"),
-                    tr("The password for\n%1@%2\nwas copied to the clipboard")
-                    .arg(a.user())
-                    .arg(a.site()),
-                    QMessageBox::Ok)
-        .exec();
+        QString password;
+
+        service_->cancel(copyRequest_);
+        copyRequest_ = 0;
+
+        if(cache_->find(a, &password))
+            copyPassword(a, password);
+        else
+        {
+            // copied once it is there (see passwordReady)
+            copyAccount_ = a;
+            copyRequest_ = service_->request(copyAccount_);
+        }
     }
 }
 
+void AccountSetView::copyPassword(const Account &a, const QString &password)
+{
+    QApplication::clipboard()->setText(password);
+    QMessageBox(QMessageBox::Information,
+                tr("Success"),
+                tr("The password for\n%1@%2\nwas copied to the clipboard")
+                .arg(a.user())
+                .arg(a.site()),
+                QMessageBox::Ok)
+    .exec();
+}
+
 void AccountSetView::cellEntered(int row, int column)
 {
-    if(column != 2 || isLocked_ || currentlyVisiblePW == row) return;
+    if(column != 2 || isLocked_ || currentlyVisiblePW == row || hoverRow_ == row) return;
 
     hideVisiblePW();
 
-    listView->item(row, column)->setText(getPassword(accounts_->at(row)));
-    currentlyVisiblePW = row;
-    QTimer::singleShot(10000, this, SLOT(hideVisiblePW()));
+    // the password of the row that was hovered before is not needed anymore
+    cancelHover();
+
+    QString password;
+    if(cache_->find(accounts_->at(row), &password))
+    {
+        showPassword(row, password);
+        return;
+    }
+
+    listView->item(row, column)->setText(tr("(creating...)"));
+    hoverRow_ = row;
+    hoverRequest_ = service_->request(accounts_->at(row));
+}
+
+void AccountSetView::cancelHover()
+{
+    if(hoverRow_ == -1) return;
+
+    service_->cancel(hoverRequest_);
+    listView->item(hoverRow_, 2)->setText(blindedPassword(accounts_->at(hoverRow_)));
+    hoverRow_ = -1;
+    hoverRequest_ = 0;
 }
 
 QWidget *AccountSetView::createDetailView()
@@ -169,6 +219,10 @@ void AccountSetView::currentItemChanged(QTreeWidgetItem *current, QTreeWidgetIte
 
     hideVisiblePW();
 
+    service_->cancel(detailRequest_);
+    detailRequest_ = 0;
+    detailRow_ = -1;
+
     const Account a = accounts_->at(current->data(1, Qt::UserRole).toInt());
     detailInfoSite->setText(a.site());
     detailInfoUser->setText(a.user());
@@ -182,13 +236,25 @@ void AccountSetView::detailInfoShowClicked()
 
     int row = tree->currentItem()->data(1, Qt::UserRole).toInt();
 
-    cellEntered(row, 2);
+    hideVisiblePW();
 
     detailInfoShow->setDown(true);
 
-    detailInfoPassword->setText(getPassword(accounts_->at(row)));
-    currentlyVisiblePW = row;
-    QTimer::singleShot(10000, this, SLOT(hideVisiblePW()));
+    service_->cancel(detailRequest_);
+    detailRequest_ = 0;
+    detailRow_ = -1;
+
+    QString password;
+    if(cache_->find(accounts_->at(row), &password))
+    {
+        detailInfoPassword->setText(password);
+        showPassword(row, password);
+        return;
+    }
+
+    detailInfoPassword->setText(tr("(creating...)"));
+    detailRow_ = row;
+    detailRequest_ = service_->request(accounts_->at(row));
 }
 
 void AccountSetView::filter(const QString &searchPhrase)
@@ -197,27 +263,56 @@ void AccountSetView::filter(const QString &searchPhrase)
     // will trigger accounts::filterChanged, which will call updateTable
 }
 
-QString AccountSetView::getPassword(const Account &a) const
+void AccountSetView::passwordReady(int id, const QString &password)
+{
+    // an empty password comes from passwordFailed
+    if(id == hoverRequest_)
+    {
+        int row = hoverRow_;
+        hoverRow_ = -1;
+        hoverRequest_ = 0;
+        if(!password.isEmpty()) cache_->insert(accounts_->at(row), password);
+        showPassword(row, password);
+    }
+    else if(id == detailRequest_)
+    {
+        int row = detailRow_;
+        detailRow_ = -1;
+        detailRequest_ = 0;
+        if(!password.isEmpty()) cache_->insert(accounts_->at(row), password);
+        detailInfoPassword->setText(password);
+        showPassword(row, password);
+    }
+    else if(id == copyRequest_)
+    {
+        copyRequest_ = 0;
+        cache_->insert(copyAccount_, password);
+        copyPassword(copyAccount_, password);
+    }
+}
+
+void AccountSetView::passwordFailed(int id, int)
+{
+    // like getpw3, an invalid account gives an empty password
+    if(id == copyRequest_)
+    {
+        copyRequest_ = 0;
+        QMessageBox(QMessageBox::Critical,
+                    tr("Password Error"),
+                    tr("The password for\n%1@%2\ncould not be created")
+                    .arg(copyAccount_.user())
+                    .arg(copyAccount_.site()),
+                    QMessageBox::Ok)
+        .exec();
+    }
+     else passwordReady(id, "");
+}
+
+void AccountSetView::showPassword(int row, const QString &password)
 {
-    QByteArray mainPW = mainPW_.toLocal8Bit();
-    QByteArray salt = a.salt().toLocal8Bit();
-    QByteArray desc = (a.site() + a.user()).toLocal8Bit();
-    struct PasswordOptions opt;
-
-    opt.mainPW = mainPW.constData();
-    opt.salt = salt.constData();
-    opt.descr = desc.constData();
-    opt.num = a.num();
-    opt.min = a.min();
-    opt.max = a.max();
-    opt.flags = a.flags();
-    opt.hash = a.algo();
-
-    char *pw = new char[a.max()+1];
-    getpw2(&opt, pw);
-    QString result = pw;
-    delete pw;
-    return result;
+    listView->item(row, 2)->setText(password);
+    currentlyVisiblePW = row;
+    QTimer::singleShot(10000, this, SLOT(hideVisiblePW()));
 }
 
 void AccountSetView::hideVisiblePW()
@@ -261,7 +356,15 @@ void AccountSetView::toggleLock(bool newstate)
         char code[11];
         getpw(b.constData(), "", 1, 10, 10, FLAGS_ALNUM, code);
 
-        if(accounts_->accessCode() != code)
+        if(accounts_->accessCode() == code)
+            key_ = hashpw_key_new(b.constData());
+
+        // our copies of the main password, only key_ (in locked memory) keeps it
+        secmem_wipe(b.data(), b.size());
+        secmem_wipe(password.data(), password.size()*sizeof(QChar));
+        secmem_wipe(code, sizeof(code));
+
+        if(key_ == 0)
         {
             QMessageBox(
                     QMessageBox::Critical,
@@ -274,7 +377,6 @@ void AccountSetView::toggleLock(bool newstate)
         {
             listView->setMouseTracking(true);
             detailInfoShow->setEnabled(true);
-            mainPW_ = password;
             isLocked_ = false;
 
             currentlyVisiblePW = -1;
@@ -282,11 +384,33 @@ void AccountSetView::toggleLock(bool newstate)
     }
      else isLocked_ = newstate;
 
+    if(isLocked_)
+    {
+        cancelHover();
+        hideVisiblePW();
+        detailRequest_ = copyRequest_ = 0;
+        warmUpTimer_->stop();
+        service_->setKey(0);    // waits until no thread uses key_
+        cache_->clear();        // the same, and wipes the passwords
+        hashpw_key_free(key_);
+        key_ = 0;
+    }
+     else
+    {
+        service_->setKey(key_);
+        warmUpCache();
+    }
+
     emit lockStateChanged();
 }
 
 void AccountSetView::updateTable()
 {
+    // the rows are about to change
+    service_->cancel(hoverRequest_);
+    service_->cancel(detailRequest_);
+    hoverRequest_ = detailRequest_ = 0;
+    hoverRow_ = detailRow_ = -1;
     currentlyVisiblePW = -1;
     listView->clearContents();  // note: will delete the items
     listView->setRowCount(accounts_->rowCount());
@@ -312,6 +436,49 @@ void AccountSetView::updateTable()
         it = new QTableWidgetItem(a.note());
         listView->setItem(i, 3, it);
     }
+
+    // the rows that are visible now first, when the user stopped typing
+    if(!isLocked_) warmUpTimer_->start();
+}
+
+void AccountSetView::warmUpCache()
+{
+    if(isLocked_) return;
+
+    QList<int> rows;
+
+    // what the user sees: the current account of the tree view or the
+    // rows of the list view that are on the screen
+    if(isTreeView() && tree->currentItem() != 0 &&
+       tree->currentItem()->data(1, Qt::UserRole).isValid())
+        rows.append(tree->currentItem()->data(1, Qt::UserRole).toInt());
+    else if(isListView() && listView->rowCount() > 0)
+    {
+        int first = listView->rowAt(0);
+        int last = listView->rowAt(listView->viewport()->height()-1);
+        if(first == -1) first = 0;
+        if(last == -1) last = listView->rowCount()-1;
+        for(int i = first; i <= last; ++i)
+            rows.append(i);
+    }
+
+    // then the others of the current filter
+    QVector<bool> queued(accounts_->rowCount(), false);
+    QList<Account> order;
+
+    foreach(int i, rows)
+    {
+        // the tree may still show the rows of the last filter
+        if(i >= queued.count() || queued[i]) continue;
+        queued[i] = true;
+        order.append(accounts_->unresolved(i));
+    }
+
+    for(int i = 0; i < accounts_->rowCount(); ++i)
+        if(!queued[i]) order.append(accounts_->unresolved(i));
+
+    // resolved and looked up by the tasks
+    cache_->warmUp(key_, order, accounts_->defaultAccount());
 }
 
 void AccountSetView::updateTree()
@@ -25,11 +25,15 @@
 
 #include "accountset.h"
 
+class PasswordCache;
+class PasswordService;
 class QLabel;
 class QPushButton;
+class QTimer;
 class QTableWidget;
 class QTreeWidget;
 class QTreeWidgetItem;
+struct hashpw_key;
 
 class AccountSetView : public QStackedWidget
 {
@@ -42,13 +46,14 @@ public:
     AccountSet *accounts() { return accounts_; }
     QString filename() const { return filename_; }
     bool isLocked() { return isLocked_; }
+    const struct hashpw_key *key() const { return key_; }   // 0 while locked
     bool isListView();
     bool isTreeView();
     void setFilename(const QString &n)
     { filename_ = n; }
 
 public slots:
-    void copyCurrentPassword() const;
+    void copyCurrentPassword();
     void hideVisiblePW();
     void switchToList();
     void switchToTree();
@@ -56,7 +61,9 @@ public slots:
 
 private:
     QString blindedPassword(const Account &a) const;
-    const QString &mainPW() const { return mainPW_; }
+    void cancelHover();
+    void copyPassword(const Account &a, const QString &password);
+    void showPassword(int row, const QString &password);
 
 private slots:
     void cellEntered(int row, int column);
@@ -64,9 +71,11 @@ private slots:
     void currentItemChanged(QTreeWidgetItem*, QTreeWidgetItem*);
     void detailInfoShowClicked();
     void filter(const QString &searchPhrase);
-    QString getPassword(const Account &a) const;
+    void passwordFailed(int id, int error);
+    void passwordReady(int id, const QString &password);
     void updateTable();
     void updateTree();
+    void warmUpCache();
 
 private:
     QTableWidget *listView;
@@ -78,7 +87,20 @@ private:
     QString filename_;
     bool isLocked_;
     int currentlyVisiblePW;     // row of password that is currently visible (or -1)
-    QString mainPW_;
+    struct hashpw_key *key_;    // derived from the main password while unlocked (or 0)
+
+    // Passwords are created in the background. A request id is 0 if
+    // there is none, the row -1.
+    PasswordService *service_;
+    int hoverRequest_, hoverRow_;       // list view, cell under the mouse
+    int detailRequest_, detailRow_;     // tree view, "Show" button
+    int copyRequest_;                   // copyCurrentPassword
+    Account copyAccount_;
+
+    // every password created while unlocked, wiped when locking; filled
+    // in the background once the filter did not change for a moment
+    PasswordCache *cache_;
+    QTimer *warmUpTimer_;
 
 signals:
     void lockStateChanged();
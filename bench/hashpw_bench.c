@@ -0,0 +1,565 @@
+/*
+ * Copyright 2010 (c) Sascha Mueller <mailbox@saschamueller.com>
+ *
+ * This file is part of qhashpw.
+ *
+ * qhashpw is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * qhashpw is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with qhashpw.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Benchmark of the password generation.
+ *
+ * First every generation path (with every backend and every multi-buffer
+ * kernel this machine supports) is checked against the known-answer vectors of kat.h
+ * and against reference_getpw2 on a fixed random corpus. Then every path
+ * is timed for every algorithm, every FLAGS_ preset, a short and a long
+ * length range, with and without FL_EVENDIST, for every scheme. The
+ * passwords of the v3 schemes have no reference, there the paths are
+ * only compared with getpw3.
+ * The results are written to stdout as JSON, errors go to stderr.
+ *
+ * usage: hashpw_bench [-n passwords] [-t threads] [-s seconds] [-b backend] [-k kernel] [-c]
+ *   -n  passwords per case (default 2000)
+ *   -t  threads of the batch path (default 0: one per CPU)
+ *   -s  minimum time per case and path (default 0.2)
+ *   -b  backend to benchmark (default: builtin)
+ *   -k  multi-buffer kernel to benchmark (default: best available)
+ *   -c  only check, do not benchmark
+ * The exit code is 1 if any check failed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "hashpw.h"
+#include "hmac_mb.h"
+#include "kat.h"
+#include "reference.h"
+
+/* room for the longest password (max-min <= 255) */
+#define RESULT_SIZE     300
+
+/* number of passwords per main password in the random corpus */
+#define CORPUS_SIZE     1000
+
+enum path
+{
+    PATH_REFERENCE,
+    PATH_GETPW,
+    PATH_GETPW2,
+    PATH_WITH_KEY,
+    PATH_GETPW3,
+    PATH_BATCH_SERIAL,
+    PATH_BATCH,
+    PATH_COUNT
+};
+
+static const char *path_names[PATH_COUNT] =
+{
+    "reference", "getpw", "getpw2", "getpw2_with_key", "getpw3",
+    "getpw2_batch_serial", "getpw2_batch"
+};
+
+static const char *hash_names[] = { "ripemd160", "sha1", "dss1", "md5", "sha256", "sha512", "blake2b" };
+static const char *scheme_names[] = { "reject", "unbiased", "stream" };
+
+static const char *kernel_names[] = { "scalar", "sse2", "avx2", "avx512" };
+
+static int batch_threads = 0;
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+/* can opt be created with the v1 function getpw? */
+static int path_applies(int path, const struct PasswordOptions *opt)
+{
+    /* no reference for the other schemes, which are not v1 either */
+    if(opt->scheme != SCHEME_REJECT && (path == PATH_REFERENCE || path == PATH_GETPW)) return 0;
+    if(path != PATH_GETPW) return 1;
+    return opt->salt[0] == 0 && opt->hash == HASH_RIPEMD160 && opt->flags <= PARAM_MAX_V1;
+}
+
+/* Create the passwords for opts[0..n) with the given path. All of them
+ * must have the same main password, which key was created from.
+ * The password i goes to results + i*RESULT_SIZE, its return code to
+ * status[i] (0 and "" if the path does not apply) */
+static void run_path(int path, const struct hashpw_key *key,
+                     const struct PasswordOptions *opts, int n,
+                     char *results, int *status)
+{
+    struct PasswordInput in;
+    int i;
+
+    if(path == PATH_BATCH_SERIAL || path == PATH_BATCH)
+    {
+        getpw2_batch(key, opts, n, results, RESULT_SIZE, status, NULL,
+                     path == PATH_BATCH ? batch_threads : 1);
+        return;
+    }
+
+    for(i = 0; i < n; ++i)
+    {
+        const struct PasswordOptions *opt = &opts[i];
+        char *result = results + i*RESULT_SIZE;
+
+        switch(path)
+        {
+        case PATH_REFERENCE:
+            status[i] = reference_getpw2(opt, result, NULL);
+            break;
+        case PATH_GETPW:
+            if(path_applies(path, opt))
+                status[i] = getpw(opt->mainPW, opt->descr, opt->num, opt->min, opt->max, opt->flags, result);
+            else
+            {
+                status[i] = 0;
+                *result = 0;
+            }
+            break;
+        case PATH_GETPW2:
+            status[i] = getpw2(opt, result);
+            break;
+        case PATH_WITH_KEY:
+            status[i] = getpw2_with_key(key, opt, result);
+            break;
+        case PATH_GETPW3:
+            init_PasswordInput(&in);
+            in.salt = opt->salt;
+            in.saltlen = strlen(opt->salt);
+            in.descr = opt->descr;
+            in.descrlen = strlen(opt->descr);
+            in.num = opt->num;
+            in.min = opt->min;
+            in.max = opt->max;
+            in.flags = opt->flags;
+            in.hash = opt->hash;
+            in.scheme = opt->scheme;
+            status[i] = getpw3(key, &in, result, RESULT_SIZE);
+            break;
+        }
+    }
+}
+
+/* Compare every path except the reference with the expected results,
+ * using every backend and every available kernel.
+ * Returns the number of mismatches */
+static int check_paths(const char *what, const struct PasswordOptions *opts, int n,
+                       const int *expected_status, const char *expected)
+{
+    char *results = (char *)malloc(n*RESULT_SIZE);
+    int *status = (int *)malloc(n*sizeof(int));
+    int failed = 0;
+    int backend, kernel, path, i;
+
+    if(results == NULL || status == NULL)
+    {
+        fprintf(stderr, "%s: out of memory\n", what);
+        free(results);
+        free(status);
+        return 1;
+    }
+
+    for(backend = 0; hashpw_backend_name(backend); ++backend)
+    {
+        struct hashpw_key *key;
+
+        hashpw_backend_select(hashpw_backend_name(backend));
+        key = hashpw_key_new(opts[0].mainPW);
+        if(key == NULL)
+        {
+            fprintf(stderr, "%s: no key for backend %s\n", what, hashpw_backend());
+            failed++;
+            continue;
+        }
+
+        for(kernel = 0; kernel < (int)(sizeof(kernel_names)/sizeof(kernel_names[0])); ++kernel)
+        {
+            if(!hmac_mb_select(kernel_names[kernel])) continue;
+
+            // the kernels are only used by the builtin backend
+            if(kernel > 0 && strcmp(hashpw_backend(), "builtin") != 0) break;
+
+            for(path = PATH_REFERENCE+1; path < PATH_COUNT; ++path)
+            {
+                run_path(path, key, opts, n, results, status);
+
+                for(i = 0; i < n; ++i)
+                {
+                    if(!path_applies(path, &opts[i])) continue;
+
+                    if(status[i] != expected_status[i] ||
+                       (status[i] == 0 && strcmp(results + i*RESULT_SIZE, expected + i*RESULT_SIZE) != 0))
+                    {
+                        if(failed < 10)
+                            fprintf(stderr, "%s \"%s\": %s/%s/%s returned %d \"%s\", expected %d \"%s\"\n",
+                                    what, opts[i].descr, path_names[path],
+                                    hashpw_backend(), kernel_names[kernel],
+                                    status[i], results + i*RESULT_SIZE,
+                                    expected_status[i], expected + i*RESULT_SIZE);
+                        failed++;
+                    }
+                }
+            }
+        }
+
+        hashpw_key_free(key);
+    }
+
+    hashpw_backend_select(NULL);
+    hmac_mb_select(NULL);
+
+    free(results);
+    free(status);
+
+    return failed;
+}
+
+/* The known-answer vectors, grouped by main password.
+ * The reference implementation itself is checked as well */
+static int check_vectors(int *checks)
+{
+    struct PasswordOptions opts[KAT_COUNT];
+    int status[KAT_COUNT];
+    static char expected[KAT_COUNT][RESULT_SIZE];
+    static char result[RESULT_SIZE];
+    int done[KAT_COUNT];
+    int failed = 0;
+    int i, j, n;
+
+    memset(done, 0, sizeof(done));
+
+    for(i = 0; i < KAT_COUNT; ++i)
+    {
+        const struct kat_vector *v = &kat_vectors[i];
+
+        if(done[i]) continue;
+
+        for(n = 0, j = i; j < KAT_COUNT; ++j)
+        {
+            const struct kat_vector *w = &kat_vectors[j];
+
+            if(done[j] || strcmp(w->mainPW, v->mainPW) != 0) continue;
+            done[j] = 1;
+
+            init_PasswordOptions(&opts[n]);
+            opts[n].mainPW = w->mainPW;
+            opts[n].salt = w->salt;
+            opts[n].descr = w->descr;
+            opts[n].num = w->num;
+            opts[n].min = w->min;
+            opts[n].max = w->max;
+            opts[n].flags = w->flags;
+            opts[n].hash = w->hash;
+            status[n] = w->ret;
+            strcpy(expected[n], w->expected);
+
+            if(reference_getpw2(&opts[n], result, NULL) != w->ret ||
+               (w->ret == 0 && strcmp(result, w->expected) != 0))
+            {
+                fprintf(stderr, "vector %d: reference implementation differs\n", j);
+                failed++;
+            }
+
+            n++;
+        }
+
+        failed += check_paths("vector", opts, n, status, expected[0]);
+        *checks += n;
+    }
+
+    return failed;
+}
+
+static unsigned long corpus_seed;
+
+/* deterministic, so the corpus is the same on every run and machine */
+static unsigned corpus_rand(void)
+{
+    corpus_seed = (corpus_seed*1103515245UL + 12345UL) & 0xffffffffUL;
+    return (unsigned)(corpus_seed >> 8);
+}
+
+static void corpus_string(char *s, int len)
+{
+    static const char chars[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 .@-_";
+    int i;
+
+    for(i = 0; i < len; ++i) s[i] = chars[corpus_rand() % (sizeof(chars)-1)];
+    s[len] = 0;
+}
+
+/* A fixed random corpus, compared with reference_getpw2 */
+static int check_corpus(int *checks)
+{
+    static const char *mainPWs[] =
+    {
+        "corpus",
+        /* exactly one block */
+        "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef",
+        /* longer than a block, hashed first */
+        "a main password that is so long that it does not fit into a single block of the hash",
+        /* exactly one block of the wide hashes */
+        "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef"
+        "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef",
+        /* longer than a block of any hash */
+        "a main password that is so long that it does not even fit into a single block of"
+        " the hashes with 64 bit words, which have blocks of 128 bytes, so it is hashed first"
+    };
+    static const unsigned flags[] = { 1, 2, 3, 4, 7, 8, 12, 15, 17, 19, 20, 23, 24, 31 };
+    static struct PasswordOptions opts[CORPUS_SIZE];
+    static char salts[CORPUS_SIZE][16];
+    static char descrs[CORPUS_SIZE][64];
+    static int status[CORPUS_SIZE];
+    static char expected[CORPUS_SIZE][RESULT_SIZE];
+    int failed = 0;
+    int p, i;
+
+    corpus_seed = 2010;
+
+    for(p = 0; p < (int)(sizeof(mainPWs)/sizeof(mainPWs[0])); ++p)
+    {
+        for(i = 0; i < CORPUS_SIZE; ++i)
+        {
+            struct PasswordOptions *opt = &opts[i];
+
+            init_PasswordOptions(opt);
+            corpus_string(salts[i], i % 4 ? 0 : corpus_rand() % 16);
+            corpus_string(descrs[i], corpus_rand() % 64);
+            opt->mainPW = mainPWs[p];
+            opt->salt = salts[i];
+            opt->descr = descrs[i];
+            opt->num = (int)(corpus_rand() % 5) - 1;
+            opt->flags = flags[corpus_rand() % (sizeof(flags)/sizeof(flags[0]))];
+            opt->min = corpus_rand() % 16;
+            opt->max = opt->min + corpus_rand() % (opt->flags & FL_EVENDIST ? 48 : 24);
+            opt->hash = corpus_rand() % (HASH_BLAKE2B+1);
+
+            status[i] = reference_getpw2(opt, expected[i], NULL);
+        }
+
+        failed += check_paths("corpus", opts, CORPUS_SIZE, status, expected[0]);
+        *checks += CORPUS_SIZE;
+    }
+
+    return failed;
+}
+
+static const struct { const char *name; unsigned flags; } presets[] =
+{
+    { "LOWER", FLAGS_LOWER },
+    { "ALPHA", FLAGS_ALPHA },
+    { "ALNUM", FLAGS_ALNUM },
+    { "PRINT", FLAGS_PRINT },
+    { "DIGIT", FLAGS_DIGIT }
+};
+
+static const struct { const char *name; int min; int max; } ranges[] =
+{
+    { "short", 8, 12 },
+    { "long", 32, 64 }
+};
+
+/* Time every path for one case. The passwords are compared with
+ * those of the reference implementation (of getpw3 if there is none),
+ * returns the number of mismatches */
+static int bench_case(int hash, int preset, int evendist, int range, int scheme, int n,
+                      double mintime, int *first)
+{
+    unsigned flags = presets[preset].flags | (evendist ? FL_EVENDIST : 0);
+    static const char mainPW[] = "benchmark main password";
+    struct PasswordOptions *opts = (struct PasswordOptions *)malloc(n*sizeof(struct PasswordOptions));
+    char (*descrs)[32] = (char (*)[32])malloc(n*32);
+    char *expected = (char *)malloc(n*RESULT_SIZE);
+    char *results = (char *)malloc(n*RESULT_SIZE);
+    int *status = (int *)malloc(n*sizeof(int));
+    struct hashpw_key *key = hashpw_key_new(mainPW);
+    long long blocks = 0;
+    double expected_blocks = 0;
+    int failed = 0;
+    int path, i;
+
+    if(opts == NULL || descrs == NULL || expected == NULL || results == NULL ||
+       status == NULL || key == NULL)
+    {
+        fprintf(stderr, "out of memory\n");
+        failed = 1;
+        goto out;
+    }
+
+    for(i = 0; i < n; ++i)
+    {
+        struct PasswordInput in;
+        struct PasswordCost cost;
+        int b;
+
+        sprintf(descrs[i], "site%05d.example.comuser", i);
+        init_PasswordOptions(&opts[i]);
+        opts[i].mainPW = mainPW;
+        opts[i].salt = "";
+        opts[i].descr = descrs[i];
+        opts[i].num = 0;
+        opts[i].min = ranges[range].min;
+        opts[i].max = ranges[range].max;
+        opts[i].flags = flags;
+        opts[i].hash = hash;
+        opts[i].scheme = scheme;
+
+        init_PasswordInput(&in);
+        in.salt = opts[i].salt;
+        in.descr = opts[i].descr;
+        in.descrlen = strlen(opts[i].descr);
+        in.min = opts[i].min;
+        in.max = opts[i].max;
+        in.flags = opts[i].flags;
+        in.hash = opts[i].hash;
+        in.scheme = opts[i].scheme;
+
+        if(scheme == SCHEME_REJECT)
+        {
+            reference_getpw2(&opts[i], expected + i*RESULT_SIZE, &b);
+            blocks += b;
+        }
+         else
+        {
+            getpw3_cost(key, &in, expected + i*RESULT_SIZE, RESULT_SIZE, &cost);
+            blocks += (long long)cost.blocks;
+        }
+
+        hashpw_estimate(&in, &cost);
+        expected_blocks += cost.blocks;
+    }
+
+    for(path = 0; path < PATH_COUNT; ++path)
+    {
+        double start, elapsed;
+        int rounds = 0;
+
+        if(!path_applies(path, &opts[0])) continue;
+
+        start = now();
+        do
+        {
+            run_path(path, key, opts, n, results, status);
+            rounds++;
+            elapsed = now() - start;
+        } while(elapsed < mintime);
+
+        for(i = 0; i < n; ++i)
+            if(status[i] != 0 || strcmp(results + i*RESULT_SIZE, expected + i*RESULT_SIZE) != 0)
+            {
+                fprintf(stderr, "%s %s%s %s %s: %s differs for password %d\n",
+                        hash_names[hash], presets[preset].name, evendist ? "|EVENDIST" : "",
+                        ranges[range].name, scheme_names[scheme], path_names[path], i);
+                failed++;
+                break;
+            }
+
+        printf("%s\n    { \"hash\": \"%s\", \"flags\": \"%s\", \"evendist\": %s,"
+               " \"range\": \"%s\", \"min\": %d, \"max\": %d, \"scheme\": \"%s\","
+               " \"path\": \"%s\", \"threads\": %d,"
+               " \"passwords\": %lld, \"blocks\": %lld, \"expected_blocks\": %.1f, \"seconds\": %.6f,"
+               " \"passwords_per_s\": %.1f, \"blocks_per_s\": %.1f, \"ns_per_password\": %.1f }",
+               *first ? "" : ",",
+               hash_names[hash], presets[preset].name, evendist ? "true" : "false",
+               ranges[range].name, ranges[range].min, ranges[range].max, scheme_names[scheme],
+               path_names[path], path == PATH_BATCH ? batch_threads : 1,
+               (long long)n*rounds, blocks*rounds, expected_blocks*rounds, elapsed,
+               n*rounds/elapsed, blocks*rounds/elapsed, elapsed*1e9/((double)n*rounds));
+        *first = 0;
+        fflush(stdout);
+    }
+
+out:
+    hashpw_key_free(key);
+    free(opts);
+    free(descrs);
+    free(expected);
+    free(results);
+    free(status);
+
+    return failed;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: hashpw_bench [-n passwords] [-t threads] [-s seconds] [-b backend] [-k kernel] [-c]\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    int n = 2000;
+    double mintime = 0.2;
+    const char *backend = NULL;
+    const char *kernel = NULL;
+    int checkonly = 0;
+    int checks = 0, failed = 0, first = 1;
+    int i, hash, preset, range, evendist, scheme;
+
+    for(i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "-c") == 0) checkonly = 1;
+        else if(i+1 >= argc) usage();
+        else if(strcmp(argv[i], "-n") == 0) n = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-t") == 0) batch_threads = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-s") == 0) mintime = atof(argv[++i]);
+        else if(strcmp(argv[i], "-b") == 0) backend = argv[++i];
+        else if(strcmp(argv[i], "-k") == 0) kernel = argv[++i];
+        else usage();
+    }
+
+    if(n < 1) usage();
+
+    failed += check_vectors(&checks);
+    failed += check_corpus(&checks);
+
+    if(!hashpw_backend_select(backend))
+    {
+        fprintf(stderr, "backend %s is not available\n", backend);
+        return 2;
+    }
+
+    if(!hmac_mb_select(kernel))
+    {
+        fprintf(stderr, "kernel %s is not available\n", kernel);
+        return 2;
+    }
+
+    printf("{\n  \"hashpw_version\": %d,\n  \"backend\": \"%s\",\n  \"kernel\": \"%s\",\n  \"lanes\": %d,\n"
+           "  \"passwords_per_case\": %d,\n  \"min_seconds\": %.3f,\n"
+           "  \"check\": { \"vectors\": %d, \"passwords\": %d, \"failures\": %d },\n"
+           "  \"results\": [",
+           HASHPW_VERSION, hashpw_backend(), hmac_mb_kernel(), hmac_mb_lanes(), n, mintime,
+           KAT_COUNT, checks, failed);
+
+    if(!checkonly && failed == 0)
+    {
+        for(hash = HASH_RIPEMD160; hash <= HASH_BLAKE2B; ++hash)
+            for(preset = 0; preset < (int)(sizeof(presets)/sizeof(presets[0])); ++preset)
+                for(range = 0; range < (int)(sizeof(ranges)/sizeof(ranges[0])); ++range)
+                    for(evendist = 0; evendist <= 1; ++evendist)
+                        for(scheme = SCHEME_REJECT; scheme <= SCHEME_STREAM; ++scheme)
+                            failed += bench_case(hash, preset, evendist, range, scheme, n, mintime, &first);
+    }
+
+    printf("\n  ],\n  \"failures\": %d\n}\n", failed);
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,21 @@
+# -------------------------------------------------
+# Benchmark and known-answer check of the password generation
+# (no Qt needed). Build with qmake && make, run ./hashpw_bench
+# -------------------------------------------------
+TARGET = hashpw_bench
+TEMPLATE = app
+CONFIG += console
+CONFIG -= qt app_bundle
+INCLUDEPATH += ..
+SOURCES += hashpw_bench.c \
+    reference.c \
+    ../hashpw.c \
+    ../hashpw_batch.c \
+    ../digest.c \
+    ../chacha20.c \
+    ../hmac_mb.c \
+    ../secmem.c
+HEADERS += kat.h \
+    reference.h
+LIBS += -lssl -lcrypto
+unix:LIBS += -lpthread -lrt -lm
@@ -0,0 +1,153 @@
+/*
+ * Copyright 2010 (c) Sascha Mueller <mailbox@saschamueller.com>
+ *
+ * This file is part of qhashpw.
+ *
+ * qhashpw is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * qhashpw is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with qhashpw.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef KAT_H
+#define KAT_H
+
+#include <limits.h>
+
+#include "hashpw.h"
+
+/* Known-answer vectors, created with reference_getpw2 (i.e. hashpw.c
+ * version 2). They cover every algorithm, every FLAGS_ preset with and
+ * without FL_EVENDIST, main passwords longer than a block, negative and
+ * extreme num values and the error codes.
+ * Never change an expected password here: a mismatch means that an
+ * optimization changed the generated passwords. */
+struct kat_vector
+{
+    const char *mainPW;
+    const char *salt;
+    const char *descr;
+    int num;
+    int min;
+    int max;
+    unsigned flags;
+    int hash;
+    int ret;                  /* return code of getpw2 */
+    const char *expected;     /* "" if ret != 0 */
+};
+
+static const struct kat_vector kat_vectors[] =
+{
+    { "secret", "", "example.comalice", 0, 8, 12, FLAGS_LOWER, HASH_RIPEMD160, 0,
+      "zbvnprcc" },
+    { "correct horse battery staple", "s4lt", "mail.example.orgbob@example.org", 1, 16, 16, FLAGS_LOWER|FL_EVENDIST, HASH_RIPEMD160, 0,
+      "ybtoqnrhalpxtvsb" },
+    { "x", "0123456789abcdef", "", 2, 1, 3, FLAGS_ALPHA, HASH_RIPEMD160, 0,
+      "zj" },
+    { "Master-Password_2010!", "", "bank\303\244user", 0, 0, 8, FLAGS_ALPHA|FL_EVENDIST, HASH_RIPEMD160, 0,
+      "UYGlqGEQ" },
+    { "This main password is longer than a single block of every hash algorithm here, so it is hashed first", "", "a", 1, 16, 16, FLAGS_ALNUM, HASH_RIPEMD160, 0,
+      "YMjl8NI1QyPuKnpG" },
+    { "secret", "s4lt", "example.comalice", 2, 6, 40, FLAGS_ALNUM|FL_EVENDIST, HASH_RIPEMD160, 0,
+      "yDjCXuCJgZ3pKHrjRLkqDCY5WfgCFAzvOGd7xG8D" },
+    { "correct horse battery staple", "0123456789abcdef", "mail.example.orgbob@example.org", 0, 0, 8, FLAGS_PRINT, HASH_RIPEMD160, 0,
+      "e?#J0eU" },
+    { "x", "", "", 1, 8, 12, FLAGS_PRINT|FL_EVENDIST, HASH_RIPEMD160, 0,
+      "PdtEZKt+iH=L" },
+    { "Master-Password_2010!", "", "bank\303\244user", 2, 6, 40, FLAGS_DIGIT, HASH_RIPEMD160, 0,
+      "3138522511144500460063822564" },
+    { "This main password is longer than a single block of every hash algorithm here, so it is hashed first", "s4lt", "a", 0, 1, 3, FLAGS_DIGIT|FL_EVENDIST, HASH_RIPEMD160, 0,
+      "801" },
+    { "secret", "0123456789abcdef", "example.comalice", 1, 8, 12, FLAGS_LOWER, HASH_SHA1, 0,
+      "prpbjagyrp" },
+    { "correct horse battery staple", "", "mail.example.orgbob@example.org", 2, 16, 16, FLAGS_LOWER|FL_EVENDIST, HASH_SHA1, 0,
+      "jiugnefzvixficzt" },
+    { "x", "", "", 0, 1, 3, FLAGS_ALPHA, HASH_SHA1, 0,
+      "B" },
+    { "Master-Password_2010!", "s4lt", "bank\303\244user", 1, 0, 8, FLAGS_ALPHA|FL_EVENDIST, HASH_SHA1, 0,
+      "NpikqIYA" },
+    { "This main password is longer than a single block of every hash algorithm here, so it is hashed first", "0123456789abcdef", "a", 2, 16, 16, FLAGS_ALNUM, HASH_SHA1, 0,
+      "7vwknYqMg9rabdrT" },
+    { "secret", "", "example.comalice", 0, 6, 40, FLAGS_ALNUM|FL_EVENDIST, HASH_SHA1, 0,
+      "VjHPjrIAWNMjJB61x9T4pvSI7AGmsVtDNcT9wt6w" },
+    { "correct horse battery staple", "", "mail.example.orgbob@example.org", 1, 0, 8, FLAGS_PRINT, HASH_SHA1, 0,
+      "" },
+    { "x", "s4lt", "", 2, 8, 12, FLAGS_PRINT|FL_EVENDIST, HASH_SHA1, 0,
+      "\"r1[<'zEobwZ" },
+    { "Master-Password_2010!", "0123456789abcdef", "bank\303\244user", 0, 6, 40, FLAGS_DIGIT, HASH_SHA1, 0,
+      "66248514851907767932555798762718" },
+    { "This main password is longer than a single block of every hash algorithm here, so it is hashed first", "", "a", 1, 1, 3, FLAGS_DIGIT|FL_EVENDIST, HASH_SHA1, 0,
+      "450" },
+    { "secret", "", "example.comalice", 2, 8, 12, FLAGS_LOWER, HASH_DSS1, 0,
+      "uuxrywwuh" },
+    { "correct horse battery staple", "s4lt", "mail.example.orgbob@example.org", 0, 16, 16, FLAGS_LOWER|FL_EVENDIST, HASH_DSS1, 0,
+      "uyrgoyztxcramlpu" },
+    { "x", "0123456789abcdef", "", 1, 1, 3, FLAGS_ALPHA, HASH_DSS1, 0,
+      "Ad" },
+    { "Master-Password_2010!", "", "bank\303\244user", 2, 0, 8, FLAGS_ALPHA|FL_EVENDIST, HASH_DSS1, 0,
+      "XcyAdMAL" },
+    { "This main password is longer than a single block of every hash algorithm here, so it is hashed first", "", "a", 0, 16, 16, FLAGS_ALNUM, HASH_DSS1, 0,
+      "c4w55G05QKZKkonq" },
+    { "secret", "s4lt", "example.comalice", 1, 6, 40, FLAGS_ALNUM|FL_EVENDIST, HASH_DSS1, 0,
+      "Y5h7i6s27qhE8X6PEwQ7Y0h4DqIxy6knPfs617IY" },
+    { "correct horse battery staple", "0123456789abcdef", "mail.example.orgbob@example.org", 2, 0, 8, FLAGS_PRINT, HASH_DSS1, 0,
+      "ZRFb" },
+    { "x", "", "", 0, 8, 12, FLAGS_PRINT|FL_EVENDIST, HASH_DSS1, 0,
+      "BAbBGGtvFZ;=" },
+    { "Master-Password_2010!", "", "bank\303\244user", 1, 6, 40, FLAGS_DIGIT, HASH_DSS1, 0,
+      "038111154413587520986709595708721743586" },
+    { "This main password is longer than a single block of every hash algorithm here, so it is hashed first", "s4lt", "a", 2, 1, 3, FLAGS_DIGIT|FL_EVENDIST, HASH_DSS1, 0,
+      "458" },
+    { "secret", "0123456789abcdef", "example.comalice", 0, 8, 12, FLAGS_LOWER, HASH_MD5, 0,
+      "ipdoayhplud" },
+    { "correct horse battery staple", "", "mail.example.orgbob@example.org", 1, 16, 16, FLAGS_LOWER|FL_EVENDIST, HASH_MD5, 0,
+      "esdtjszoturbnslx" },
+    { "x", "", "", 2, 1, 3, FLAGS_ALPHA, HASH_MD5, 0,
+      "Q" },
+    { "Master-Password_2010!", "s4lt", "bank\303\244user", 0, 0, 8, FLAGS_ALPHA|FL_EVENDIST, HASH_MD5, 0,
+      "zKNHvRQM" },
+    { "This main password is longer than a single block of every hash algorithm here, so it is hashed first", "0123456789abcdef", "a", 1, 16, 16, FLAGS_ALNUM, HASH_MD5, 0,
+      "2SvGQ8UpKlHAwlGb" },
+    { "secret", "", "example.comalice", 2, 6, 40, FLAGS_ALNUM|FL_EVENDIST, HASH_MD5, 0,
+      "WQszdCGalaN1AVQVdKIhPHnEZuMDUKxrDzV2dhpS" },
+    { "correct horse battery staple", "", "mail.example.orgbob@example.org", 0, 0, 8, FLAGS_PRINT, HASH_MD5, 0,
+      "" },
+    { "x", "s4lt", "", 1, 8, 12, FLAGS_PRINT|FL_EVENDIST, HASH_MD5, 0,
+      "]Sl'S}g56##P" },
+    { "Master-Password_2010!", "0123456789abcdef", "bank\303\244user", 2, 6, 40, FLAGS_DIGIT, HASH_MD5, 0,
+      "315935864952981418" },
+    { "This main password is longer than a single block of every hash algorithm here, so it is hashed first", "", "a", 0, 1, 3, FLAGS_DIGIT|FL_EVENDIST, HASH_MD5, 0,
+      "450" },
+    { "secret", "", "example.comalice", -1, 8, 12, FLAGS_PRINT, HASH_RIPEMD160, 0,
+      ".ZSCYUs<d#" },
+    { "secret", "", "example.comalice", INT_MIN, 8, 12, FLAGS_ALNUM, HASH_SHA1, 0,
+      "pYuIeHQx6" },
+    { "secret", "", "example.comalice", INT_MAX, 8, 12, FLAGS_ALNUM, HASH_MD5, 0,
+      "R9yFZwdwnO" },
+    { "secret", "salt", "example.comalice", 0, 0, 255, FLAGS_PRINT, HASH_DSS1, 0,
+      "CX5PcIAo$5*BAz+ZH?_=/ERFFu-lx#.5uLv@H6bB=#7_Hl\"+2j1zbG{;j4gr@OS}F6]lJ)lx1v*kI\\]S}WBMj:zgjVq1TeSyBMA]gt#g?8xvb<zXdA9Gc(9t>LK{&Hwa*PNlfDIAgp(OaqPQ;RQ?lj~1gHO@.?wSLxaax#Zza[;%\\1#PgB" },
+    { "secret", "salt", "example.comalice", 0, 0, 255, FLAGS_ALNUM, HASH_RIPEMD160, 0,
+      "yPp2HkWsDU6BagOEMqFu8hkFYXDylPCv6vxo2O10DDXymmAdakZiyiLyNdiG5vTlYFKCsGJlauzwIZDqUe8iU3lti77hQZvrgElmDS744aA42wDEY28dD4GmVC0veRr2v8ESs4DMOHdUEYjQMqPf0DciPhnu2fLKQsw5YtXoDiwbu39VWS9Ub9slCwDSqULCeyY0T0lg9f4ryeL4mqKZ8tUjtdFQnDkcQf" },
+    { "secret", "salt", "example.comalice", 0, 64, 64, FL_SPECIAL, HASH_MD5, 0,
+      "~?(?<|:\"{!<\\$\\{%:};&\\;\"?[(#:;>+[>/<]&^!]-%?[?$*\\{({!('\\@%-;$+?[|" },
+    { "secret", "", "example.comalice", 0, 0, 2, FLAGS_LOWER|FL_EVENDIST, HASH_SHA1, 0,
+      "jj" },
+    { "", "", "", 0, 10, 10, FLAGS_ALNUM, HASH_RIPEMD160, 0,
+      "NfKwYv13OY" },
+    { "secret", "", "example.comalice", 0, 8, 12, 32, HASH_RIPEMD160, -2,
+      "" },
+    { "secret", "", "example.comalice", 0, 0, 256, FLAGS_PRINT, HASH_RIPEMD160, -3,
+      "" },
+};
+
+#define KAT_COUNT       ((int)(sizeof(kat_vectors)/sizeof(kat_vectors[0])))
+
+#endif // KAT_H
@@ -0,0 +1,39 @@
+/*
+ * Copyright 2010 (c) Sascha Mueller <mailbox@saschamueller.com>
+ *
+ * This file is part of qhashpw.
+ *
+ * qhashpw is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * qhashpw is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with qhashpw.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REFERENCE_H
+#define REFERENCE_H
+
+#include "hashpw.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* getpw2 exactly as it was before any optimization: one full HMAC() call
+ * per block and ctype tests for every byte. It is slow on purpose, and
+ * every optimized path must give the same results.
+ * If blocks is not NULL, the number of HMAC blocks is stored there. */
+int reference_getpw2(const struct PasswordOptions *opt, char *result, int *blocks);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // REFERENCE_H
@@ -0,0 +1,83 @@
+/*
+ * Copyright 2010 (c) Sascha Mueller <mailbox@saschamueller.com>
+ *
+ * This file is part of qhashpw.
+ *
+ * qhashpw is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * qhashpw is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with qhashpw.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "chacha20.h"
+
+#define ROTL(x, n)      (((x) << (n)) | ((x) >> (32-(n))))
+
+#define QUARTERROUND(a, b, c, d) \
+    a += b; d ^= a; d = ROTL(d, 16); \
+    c += d; b ^= c; b = ROTL(b, 12); \
+    a += b; d ^= a; d = ROTL(d, 8); \
+    c += d; b ^= c; b = ROTL(b, 7)
+
+static uint32_t load32(const unsigned char *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+void chacha20_init(struct chacha20_ctx *c, const unsigned char *key,
+                   const unsigned char *nonce, uint32_t counter)
+{
+    int i;
+
+    // "expand 32-byte k"
+    c->state[0] = 0x61707865;
+    c->state[1] = 0x3320646e;
+    c->state[2] = 0x79622d32;
+    c->state[3] = 0x6b206574;
+    for(i = 0; i < 8; ++i)
+        c->state[4+i] = load32(key + 4*i);
+    c->state[12] = counter;
+    for(i = 0; i < 3; ++i)
+        c->state[13+i] = load32(nonce + 4*i);
+}
+
+void chacha20_block(struct chacha20_ctx *c, unsigned char *out)
+{
+    uint32_t x[16];
+    int i;
+
+    for(i = 0; i < 16; ++i) x[i] = c->state[i];
+
+    for(i = 0; i < 10; ++i)
+    {
+        // column rounds
+        QUARTERROUND(x[0], x[4], x[8],  x[12]);
+        QUARTERROUND(x[1], x[5], x[9],  x[13]);
+        QUARTERROUND(x[2], x[6], x[10], x[14]);
+        QUARTERROUND(x[3], x[7], x[11], x[15]);
+        // diagonal rounds
+        QUARTERROUND(x[0], x[5], x[10], x[15]);
+        QUARTERROUND(x[1], x[6], x[11], x[12]);
+        QUARTERROUND(x[2], x[7], x[8],  x[13]);
+        QUARTERROUND(x[3], x[4], x[9],  x[14]);
+    }
+
+    for(i = 0; i < 16; ++i)
+    {
+        uint32_t v = x[i] + c->state[i];
+        out[4*i]   = (unsigned char)v;
+        out[4*i+1] = (unsigned char)(v >> 8);
+        out[4*i+2] = (unsigned char)(v >> 16);
+        out[4*i+3] = (unsigned char)(v >> 24);
+    }
+
+    c->state[12]++;
+}
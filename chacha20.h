@@ -0,0 +1,52 @@
+/*
+ * Copyright 2010 (c) Sascha Mueller <mailbox@saschamueller.com>
+ *
+ * This file is part of qhashpw.
+ *
+ * qhashpw is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * qhashpw is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with qhashpw.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CHACHA20_H
+#define CHACHA20_H
+
+#include <stdint.h>
+
+/* The ChaCha20 stream cipher of RFC 8439, used as the keystream
+ * that SCHEME_STREAM expands its seed with */
+
+#define CHACHA20_KEY_SIZE       32
+#define CHACHA20_NONCE_SIZE     12
+#define CHACHA20_BLOCK_SIZE     64
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct chacha20_ctx
+{
+    uint32_t state[16];     /* constants, key, block counter, nonce */
+};
+
+void chacha20_init(struct chacha20_ctx *c, const unsigned char *key,
+                   const unsigned char *nonce, uint32_t counter);
+
+/* Write the keystream block of the current counter to out
+ * and advance the counter */
+void chacha20_block(struct chacha20_ctx *c, unsigned char *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CHACHA20_H
@@ -0,0 +1,240 @@
+/*
+ * Copyright 2010 (c) Sascha Mueller <mailbox@saschamueller.com>
+ *
+ * This file is part of qhashpw.
+ *
+ * qhashpw is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * qhashpw is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with qhashpw.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Command line interface: creates the passwords of the accounts of a
+ * file without a display, for scripts. Needs QtCore only. */
+
+#include <cstdio>
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QFile>
+#include <QtCore/QList>
+#include <QtCore/QStringList>
+
+#include "accountset.h"
+#include "hashpw.h"
+#include "passwordbatch.h"
+#include "secmem.h"
+#include "tokenizer.h"
+
+// Accounts per PasswordBatch, so output starts early and memory stays
+// bounded for large files
+static const int CHUNK = 4096;
+
+static void usage()
+{
+    fprintf(stderr,
+            "Usage: qhashpw_cli [options] FILE\n"
+            "Creates the passwords of the accounts in FILE and writes them to stdout,\n"
+            "one account per line. The main password is read from the first line of\n"
+            "stdin.\n"
+            "\n"
+            "  -f, --filter PHRASE  only accounts whose site or note contains PHRASE\n"
+            "  -o, --format FORMAT  tsv (site, user, password; the default) or ndjson\n"
+            "  -j, --threads N      number of threads (default: one per CPU)\n"
+            "  --password-fd N      read the main password from file descriptor N\n"
+            "\n"
+            "Exit status: 0 on success, 1 if some passwords could not be created,\n"
+            "2 on other errors.\n");
+}
+
+// s as a JSON string
+static QByteArray json(const QByteArray &s)
+{
+    QByteArray r("\"");
+    for(int i = 0; i < s.size(); ++i)
+    {
+        unsigned char c = s[i];
+        if(c == '"' || c == '\\')
+            r.append('\\').append(char(c));
+        else if(c < 0x20)
+            r.append(QString().sprintf("\\u%04x", c).toLatin1());
+        else
+            r.append(char(c));
+    }
+    return r.append('"');
+}
+
+// s as a TSV field
+static QByteArray tsv(const QByteArray &s)
+{
+    QByteArray r;
+    for(int i = 0; i < s.size(); ++i)
+    {
+        switch(s[i])
+        {
+        case '\\': r.append("\\\\"); break;
+        case '\t': r.append("\\t"); break;
+        case '\n': r.append("\\n"); break;
+        case '\r': r.append("\\r"); break;
+        default: r.append(s[i]);
+        }
+    }
+    return r;
+}
+
+// The first line from fd without the line break
+static bool readPassword(int fd, QByteArray *pw)
+{
+    QFile f;
+    if(!f.open(fd, QIODevice::ReadOnly)) return false;
+
+    *pw = f.readLine();
+    while(pw->endsWith('\n') || pw->endsWith('\r')) pw->chop(1);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QStringList args = app.arguments();
+    QString filename, filter;
+    bool ndjson = false;
+    int threads = 0, fd = 0;
+
+    for(int i = 1; i < args.count(); ++i)
+    {
+        const QString &a = args[i];
+        bool hasValue = i+1 < args.count(), ok = true;
+
+        if((a == "-f" || a == "--filter") && hasValue)
+            filter = args[++i];
+        else if((a == "-o" || a == "--format") && hasValue)
+        {
+            QString f = args[++i];
+            ok = f == "tsv" || f == "ndjson";
+            ndjson = f == "ndjson";
+        }
+        else if((a == "-j" || a == "--threads") && hasValue)
+            threads = args[++i].toInt(&ok);
+        else if(a == "--password-fd" && hasValue)
+            fd = args[++i].toInt(&ok);
+        else if(a == "-h" || a == "--help")
+        {
+            usage();
+            return 0;
+        }
+        else if(!a.startsWith('-') && filename.isEmpty())
+            filename = a;
+        else
+            ok = false;
+
+        if(!ok)
+        {
+            usage();
+            return 2;
+        }
+    }
+
+    if(filename.isEmpty())
+    {
+        usage();
+        return 2;
+    }
+
+    QFile f(filename);
+    if(!f.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        fprintf(stderr, "qhashpw_cli: cannot open %s\n", qPrintable(filename));
+        return 2;
+    }
+
+    AccountSet accounts;
+    {
+        Tokenizer t(&f);
+        if(t.error() != Tokenizer::NO_ERROR || !accounts.readFrom(&t))
+        {
+            fprintf(stderr, "qhashpw_cli: %s: %s\n", qPrintable(filename),
+                    qPrintable(accounts.errorMsg()));
+            return 2;
+        }
+    }
+    accounts.filter(filter);
+
+    // the same check as AccountSetView::toggleLock
+    QByteArray pw;
+    if(!readPassword(fd, &pw))
+    {
+        fprintf(stderr, "qhashpw_cli: cannot read the main password\n");
+        return 2;
+    }
+
+    char code[11];
+    struct hashpw_key *key = 0;
+    getpw(pw.constData(), "", 1, 10, 10, FLAGS_ALNUM, code);
+    if(accounts.accessCode() == code)
+        key = hashpw_key_new(pw.constData());
+    secmem_wipe(pw.data(), pw.size());
+    secmem_wipe(code, sizeof(code));
+
+    if(key == 0)
+    {
+        fprintf(stderr, "qhashpw_cli: main password not correct\n");
+        return 2;
+    }
+
+    QFile out;
+    out.open(stdout, QIODevice::WriteOnly);
+    int failed = 0;
+
+    for(int first = 0; first < accounts.rowCount(); first += CHUNK)
+    {
+        QList<Account> chunk;
+        for(int i = first; i < qMin(first+CHUNK, accounts.rowCount()); ++i)
+            chunk.append(accounts.at(i));
+
+        PasswordBatch batch(chunk);
+        failed += batch.generate(key, threads);
+
+        for(int i = 0; i < batch.count(); ++i)
+        {
+            QByteArray site = batch.account(i).site().toUtf8();
+            QByteArray user = batch.account(i).user().toUtf8();
+            QByteArray line;
+
+            if(batch.status(i) != 0)
+                fprintf(stderr, "qhashpw_cli: %s@%s: error %d\n",
+                        user.constData(), site.constData(), batch.status(i));
+
+            // passwords are ASCII
+            QByteArray password = batch.password(i).toLatin1();
+
+            if(ndjson)
+            {
+                line = "{\"site\":" + json(site) + ",\"user\":" + json(user);
+                if(batch.status(i) == 0)
+                    line += ",\"password\":" + json(password) + "}\n";
+                else
+                    line += ",\"error\":" + QByteArray::number(batch.status(i)) + "}\n";
+            }
+            else
+                line = tsv(site) + '\t' + tsv(user) + '\t' + tsv(password) + '\n';
+
+            out.write(line);
+            secmem_wipe(line.data(), line.size());
+            secmem_wipe(password.data(), password.size());
+        }
+
+        out.flush();
+    }
+
+    hashpw_key_free(key);
+
+    return failed ? 1 : 0;
+}
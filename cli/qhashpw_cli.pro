@@ -0,0 +1,39 @@
+# -------------------------------------------------
+# Command line interface (QtCore only, no display needed).
+# Build with qmake && make, see ./qhashpw_cli --help
+# -------------------------------------------------
+TARGET = qhashpw_cli
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+QT -= gui
+INCLUDEPATH += ..
+SOURCES += qhashpw_cli.cpp \
+    ../account.cpp \
+    ../accountset.cpp \
+    ../tokenizer.cpp \
+    ../tokscan.c \
+    ../passwordbatch.cpp \
+    ../taskscheduler.cpp \
+    ../hashpw.c \
+    ../hashpw_batch.c \
+    ../digest.c \
+    ../chacha20.c \
+    ../hmac_mb.c \
+    ../secmem.c
+HEADERS += ../account.h \
+    ../accountset.h \
+    ../tokenizer.h \
+    ../tokscan.h \
+    ../passwordbatch.h \
+    ../taskscheduler.h \
+    ../hashpw.h \
+    ../secmem.h
+# "qmake CONFIG+=nossl" builds without OpenSSL,
+# using only the builtin hash backend
+nossl {
+    DEFINES += HASHPW_NO_OPENSSL
+} else {
+    LIBS += -lssl -lcrypto
+}
+unix:LIBS += -lpthread -lm
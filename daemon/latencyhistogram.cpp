@@ -0,0 +1,90 @@
+/*
+ * Copyright 2010 (c) Sascha Mueller <mailbox@saschamueller.com>
+ *
+ * This file is part of qhashpw.
+ *
+ * qhashpw is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * qhashpw is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with qhashpw.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtCore/QStringList>
+
+#include "latencyhistogram.h"
+
+// Values below 8 get a bucket each, above that 8 per power of two
+static const int SUB = 8;
+
+LatencyHistogram::LatencyHistogram()
+: buckets_(SUB*62, 0), count_(0), max_(0)
+{
+}
+
+int LatencyHistogram::bucket(quint64 ns)
+{
+    if(ns < SUB) return int(ns);
+
+    int o = 3;  // position of the leading bit
+    while(ns >> (o+1)) o++;
+    return (o-2)*SUB + int((ns >> (o-3)) & (SUB-1));
+}
+
+quint64 LatencyHistogram::upperBound(int b)
+{
+    if(b < SUB) return b;
+
+    int o = b/SUB + 2;
+    return ((quint64(SUB + b%SUB) + 1) << (o-3)) - 1;
+}
+
+void LatencyHistogram::record(quint64 ns)
+{
+    buckets_[bucket(ns)]++;
+    count_++;
+    if(ns > max_) max_ = ns;
+}
+
+void LatencyHistogram::clear()
+{
+    buckets_.fill(0);
+    count_ = max_ = 0;
+}
+
+quint64 LatencyHistogram::percentile(double p) const
+{
+    quint64 rank = quint64(p/100*count_ + 0.5), seen = 0;
+    if(rank == 0) rank = 1;
+
+    for(int b = 0; b < buckets_.size(); ++b)
+    {
+        seen += buckets_[b];
+        if(seen >= rank) return qMin(upperBound(b), max_);
+    }
+    return max_;
+}
+
+QString LatencyHistogram::toString() const
+{
+    QStringList s;
+    s << QString("count=%1").arg(count_)
+      << QString("p50=%1us").arg(percentile(50)/1000.0, 0, 'f', 1)
+      << QString("p90=%1us").arg(percentile(90)/1000.0, 0, 'f', 1)
+      << QString("p99=%1us").arg(percentile(99)/1000.0, 0, 'f', 1)
+      << QString("p99.9=%1us").arg(percentile(99.9)/1000.0, 0, 'f', 1)
+      << QString("max=%1us").arg(max_/1000.0, 0, 'f', 1);
+
+    for(int b = 0; b < buckets_.size(); ++b)
+        if(buckets_[b])
+            s << QString("%1:%2").arg(upperBound(b)).arg(buckets_[b]);
+
+    return s.join("\t");
+}
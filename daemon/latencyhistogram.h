@@ -0,0 +1,55 @@
+/*
+ * Copyright 2010 (c) Sascha Mueller <mailbox@saschamueller.com>
+ *
+ * This file is part of qhashpw.
+ *
+ * qhashpw is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * qhashpw is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with qhashpw.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+// Histogram of latencies in nanoseconds with 8 buckets per power of two,
+// so every percentile is accurate to 12.5%
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    void record(quint64 ns);
+    void clear();
+
+    inline quint64 count() const { return count_; }
+    inline quint64 max() const { return max_; }
+
+    // Upper bound of the bucket that holds the p-th percentile (0 < p <= 100)
+    quint64 percentile(double p) const;
+
+    // count, p50, p90, p99, p99.9 and max in microseconds, followed by
+    // the non-empty buckets as <upper bound>:<count>, separated by tabs
+    QString toString() const;
+
+private:
+    static int bucket(quint64 ns);
+    static quint64 upperBound(int bucket);
+
+    QVector<quint64> buckets_;
+    quint64 count_;
+    quint64 max_;
+};
+
+#endif // LATENCYHISTOGRAM_H
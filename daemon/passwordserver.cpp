@@ -0,0 +1,234 @@
+/*
+ * Copyright 2010 (c) Sascha Mueller <mailbox@saschamueller.com>
+ *
+ * This file is part of qhashpw.
+ *
+ * qhashpw is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * qhashpw is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with qhashpw.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtCore/QFile>
+#include <QtCore/QTimer>
+#include <QtNetwork/QLocalServer>
+#include <QtNetwork/QLocalSocket>
+
+#include "accountset.h"
+#include "hashpw.h"
+#include "passwordbatch.h"
+#include "passwordserver.h"
+#include "secmem.h"
+#include "tokenizer.h"
+
+// Longest request line, longer ones close the connection
+static const int MAX_LINE = 8192;
+
+// Batches smaller than this are created in the calling thread, starting
+// threads would take longer than the passwords
+static const int PARALLEL_BATCH = 64;
+
+PasswordServer::PasswordServer(QObject *parent)
+: QObject(parent), server_(new QLocalServer(this)), key_(0), flushScheduled_(false)
+{
+    connect(server_, SIGNAL(newConnection()), SLOT(newConnection()));
+    clock_.start();
+}
+
+PasswordServer::~PasswordServer()
+{
+    hashpw_key_free(key_);
+}
+
+bool PasswordServer::load(const QString &filename, const QByteArray &mainPW, QString *error)
+{
+    QFile f(filename);
+    if(!f.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        *error = tr("%1: cannot open").arg(filename);
+        return false;
+    }
+
+    AccountSet set;
+    Tokenizer t(&f);
+    if(t.error() != Tokenizer::NO_ERROR || !set.readFrom(&t))
+    {
+        *error = tr("%1: %2").arg(filename).arg(set.errorMsg());
+        return false;
+    }
+
+    // the same check as AccountSetView::toggleLock
+    char code[11];
+    getpw(mainPW.constData(), "", 1, 10, 10, FLAGS_ALNUM, code);
+    bool ok = set.accessCode() == code;
+    secmem_wipe(code, sizeof(code));
+
+    if(!ok)
+    {
+        *error = tr("%1: main password not correct").arg(filename);
+        return false;
+    }
+
+    if(key_ == 0 && (key_ = hashpw_key_new(mainPW.constData())) == 0)
+    {
+        *error = tr("cannot create the key");
+        return false;
+    }
+
+    // the first account with a site and user wins
+    for(int i = 0; i < set.rowCount(); ++i)
+    {
+        Account a = set.at(i);
+        QString id = a.site() + '\t' + a.user();
+        if(!index_.contains(id)) index_.insert(id, accounts_.count());
+        accounts_.append(a);
+    }
+
+    return true;
+}
+
+bool PasswordServer::listen(const QString &path, QString *error)
+{
+    QLocalServer::removeServer(path);
+    if(!server_->listen(path))
+    {
+        *error = server_->errorString();
+        return false;
+    }
+    return true;
+}
+
+void PasswordServer::newConnection()
+{
+    while(QLocalSocket *s = server_->nextPendingConnection())
+    {
+        connect(s, SIGNAL(readyRead()), SLOT(readyRead()));
+        connect(s, SIGNAL(disconnected()), SLOT(disconnected()));
+    }
+}
+
+void PasswordServer::disconnected()
+{
+    // its pending requests are dropped by the QPointer
+    sender()->deleteLater();
+}
+
+void PasswordServer::readyRead()
+{
+    QLocalSocket *s = qobject_cast<QLocalSocket *>(sender());
+    if(s == 0) return;
+
+    while(s->canReadLine())
+    {
+        QByteArray line = s->readLine(MAX_LINE+1);
+        if(!line.endsWith('\n'))
+        {
+            s->abort();
+            return;
+        }
+        while(line.endsWith('\n') || line.endsWith('\r')) line.chop(1);
+
+        Request r;
+        r.socket = s;
+        r.args = line.split('\t');
+        r.command = r.args.takeFirst();
+        r.start = clock_.nsecsElapsed();
+        pending_.append(r);
+    }
+
+    if(s->bytesAvailable() > MAX_LINE)
+    {
+        s->abort();
+        return;
+    }
+
+    // Answered once the event loop is idle, so everything that came in
+    // meanwhile goes into the same batch
+    if(!pending_.isEmpty() && !flushScheduled_)
+    {
+        flushScheduled_ = true;
+        QTimer::singleShot(0, this, SLOT(flush()));
+    }
+}
+
+void PasswordServer::answer(const Request &r, const QByteArray &response)
+{
+    if(r.socket) r.socket->write(response);
+    latency_.record(clock_.nsecsElapsed() - r.start);
+}
+
+void PasswordServer::flush()
+{
+    QList<Request> requests = pending_;
+    pending_.clear();
+    flushScheduled_ = false;
+
+    // all GETs of this round in one batch
+    QList<Account> accounts;
+    QList<int> batchIndex;              // per request, -1 if no GET
+    for(int i = 0; i < requests.count(); ++i)
+    {
+        const Request &r = requests[i];
+        int a = -1;
+        if(r.command == "GET" && r.args.count() == 2)
+            a = index_.value(QString::fromUtf8(r.args[0]) + '\t' + QString::fromUtf8(r.args[1]), -1);
+        batchIndex.append(a < 0 ? -1 : accounts.count());
+        if(a >= 0) accounts.append(accounts_[a]);
+    }
+
+    PasswordBatch batch(accounts);
+    if(batch.count())
+        batch.generate(key_, batch.count() < PARALLEL_BATCH ? 1 : 0);
+
+    for(int i = 0; i < requests.count(); ++i)
+    {
+        const Request &r = requests[i];
+        int b = batchIndex[i];
+
+        if(b >= 0)
+        {
+            if(batch.status(b) != 0)
+            {
+                answer(r, "err\t" + QByteArray::number(batch.status(b)) + '\n');
+                continue;
+            }
+
+            QByteArray response = "ok\t" + batch.password(b).toLatin1() + '\n';
+            answer(r, response);
+            secmem_wipe(response.data(), response.size());
+        }
+        else if(r.command == "GET")
+            answer(r, "err\tno such account\n");
+        else if(r.command == "FIND" && r.args.count() <= 1)
+        {
+            QString phrase = r.args.isEmpty() ? QString() : QString::fromUtf8(r.args[0]);
+            QByteArray lines;
+            int n = 0;
+            foreach(const Account &a, accounts_)
+                if(a.site().contains(phrase, Qt::CaseInsensitive) ||
+                   a.note().contains(phrase, Qt::CaseInsensitive))
+                {
+                    lines += a.site().toUtf8() + '\t' + a.user().toUtf8() + '\n';
+                    n++;
+                }
+            answer(r, "ok\t" + QByteArray::number(n) + '\n' + lines);
+        }
+        else if(r.command == "STATS")
+            answer(r, "ok\t" + latency_.toString().toLatin1() + '\n');
+        else if(r.command == "RESET")
+        {
+            latency_.clear();
+            answer(r, "ok\n");
+        }
+        else
+            answer(r, "err\tunknown request\n");
+    }
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright 2010 (c) Sascha Mueller <mailbox@saschamueller.com>
+ *
+ * This file is part of qhashpw.
+ *
+ * qhashpw is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * qhashpw is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with qhashpw.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PASSWORDSERVER_H
+#define PASSWORDSERVER_H
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QObject>
+#include <QtCore/QPointer>
+#include <QtCore/QStringList>
+
+#include "account.h"
+#include "latencyhistogram.h"
+
+class QLocalServer;
+class QLocalSocket;
+struct hashpw_key;
+
+// Answers password requests on a local socket, one request per line,
+// fields separated by tabs:
+//   GET <site> <user>   -> ok <password>         | err <message>
+//   FIND <phrase>       -> ok <n>, then n lines <site> <user>
+//                          (site or note contains phrase, like the filter)
+//   STATS               -> ok <see LatencyHistogram::toString>
+//   RESET               -> ok  (clears the statistics)
+// Requests are answered in order. Those that arrive while passwords are
+// created are collected and handed to one PasswordBatch together.
+class PasswordServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    PasswordServer(QObject *parent = 0);
+    ~PasswordServer();
+
+    // Add the accounts of an account file, whose access code must match
+    // mainPW. Returns false and sets *error on failure
+    bool load(const QString &filename, const QByteArray &mainPW, QString *error);
+
+    // Start listening on the socket at path (removing a stale one)
+    bool listen(const QString &path, QString *error);
+
+    inline int accountCount() const { return accounts_.count(); }
+
+private slots:
+    void newConnection();
+    void readyRead();
+    void disconnected();
+    void flush();
+
+private:
+    struct Request
+    {
+        QPointer<QLocalSocket> socket;
+        QByteArray command;
+        QList<QByteArray> args;
+        qint64 start;               // on clock_, ns
+    };
+
+    void answer(const Request &r, const QByteArray &response);
+
+    QLocalServer *server_;
+    struct hashpw_key *key_;        // 0 until the first file is loaded
+    QList<Account> accounts_;
+    QHash<QString, int> index_;     // site + '\t' + user -> accounts_
+    QList<Request> pending_;
+    bool flushScheduled_;
+    QElapsedTimer clock_;
+    LatencyHistogram latency_;
+};
+
+#endif // PASSWORDSERVER_H
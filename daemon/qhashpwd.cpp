@@ -0,0 +1,118 @@
+/*
+ * Copyright 2010 (c) Sascha Mueller <mailbox@saschamueller.com>
+ *
+ * This file is part of qhashpw.
+ *
+ * qhashpw is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * qhashpw is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with qhashpw.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Password daemon: loads account files once and answers requests on a
+ * local socket (see PasswordServer). Needs QtCore and QtNetwork only. */
+
+#include <cstdio>
+
+#include <sys/stat.h>
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QStringList>
+
+#include "passwordserver.h"
+#include "secmem.h"
+
+static void usage()
+{
+    fprintf(stderr,
+            "Usage: qhashpwd [options] FILE...\n"
+            "Loads the account files and answers password requests on a local\n"
+            "socket until it is killed. The main password, which must unlock every\n"
+            "file, is read from the first line of stdin.\n"
+            "\n"
+            "  -s, --socket PATH    socket to listen on (default: ~/.qhashpwd.sock)\n"
+            "  --password-fd N      read the main password from file descriptor N\n");
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QStringList args = app.arguments(), files;
+    QString path = QDir::homePath() + "/.qhashpwd.sock";
+    int fd = 0;
+
+    for(int i = 1; i < args.count(); ++i)
+    {
+        const QString &a = args[i];
+        bool hasValue = i+1 < args.count(), ok = true;
+
+        if((a == "-s" || a == "--socket") && hasValue)
+            path = args[++i];
+        else if(a == "--password-fd" && hasValue)
+            fd = args[++i].toInt(&ok);
+        else if(a == "-h" || a == "--help")
+        {
+            usage();
+            return 0;
+        }
+        else if(!a.startsWith('-'))
+            files << a;
+        else
+            ok = false;
+
+        if(!ok)
+        {
+            usage();
+            return 2;
+        }
+    }
+
+    if(files.isEmpty())
+    {
+        usage();
+        return 2;
+    }
+
+    QFile in;
+    QByteArray pw;
+    if(!in.open(fd, QIODevice::ReadOnly))
+    {
+        fprintf(stderr, "qhashpwd: cannot read the main password\n");
+        return 2;
+    }
+    pw = in.readLine();
+    while(pw.endsWith('\n') || pw.endsWith('\r')) pw.chop(1);
+    in.close();
+
+    PasswordServer server;
+    QString error;
+    bool ok = true;
+
+    foreach(const QString &f, files)
+        if(!(ok = server.load(f, pw, &error))) break;
+    secmem_wipe(pw.data(), pw.size());
+
+    // nobody but us may connect
+    umask(077);
+
+    if(!ok || !server.listen(path, &error))
+    {
+        fprintf(stderr, "qhashpwd: %s\n", qPrintable(error));
+        return 2;
+    }
+
+    fprintf(stderr, "qhashpwd: %d accounts, listening on %s\n",
+            server.accountCount(), qPrintable(path));
+
+    return app.exec();
+}
@@ -0,0 +1,44 @@
+# -------------------------------------------------
+# Password daemon (QtCore and QtNetwork, no display needed).
+# Build with qmake && make, see ./qhashpwd --help
+# -------------------------------------------------
+TARGET = qhashpwd
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+QT -= gui
+QT += network
+INCLUDEPATH += ..
+SOURCES += qhashpwd.cpp \
+    passwordserver.cpp \
+    latencyhistogram.cpp \
+    ../account.cpp \
+    ../accountset.cpp \
+    ../tokenizer.cpp \
+    ../tokscan.c \
+    ../passwordbatch.cpp \
+    ../taskscheduler.cpp \
+    ../hashpw.c \
+    ../hashpw_batch.c \
+    ../digest.c \
+    ../chacha20.c \
+    ../hmac_mb.c \
+    ../secmem.c
+HEADERS += passwordserver.h \
+    latencyhistogram.h \
+    ../account.h \
+    ../accountset.h \
+    ../tokenizer.h \
+    ../tokscan.h \
+    ../passwordbatch.h \
+    ../taskscheduler.h \
+    ../hashpw.h \
+    ../secmem.h
+# "qmake CONFIG+=nossl" builds without OpenSSL,
+# using only the builtin hash backend
+nossl {
+    DEFINES += HASHPW_NO_OPENSSL
+} else {
+    LIBS += -lssl -lcrypto
+}
+unix:LIBS += -lpthread -lm
@@ -0,0 +1,341 @@
+/*
+ * Copyright 2010 (c) Sascha Mueller <mailbox@saschamueller.com>
+ *
+ * This file is part of qhashpw.
+ *
+ * qhashpw is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * qhashpw is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with qhashpw.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Load generator for qhashpwd: every connection sends GET requests for
+ * random accounts (from a FIND) and measures the latency of the answers.
+ * Without a rate, each connection sends the next request as soon as the
+ * answer is there; with -r the requests are sent on a fixed schedule and
+ * the latency counts from the scheduled time, so a stalled server is not
+ * hidden by requests that were never sent. No Qt needed. */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+struct conn
+{
+    int fd;
+    char buf[65536];
+    size_t len;                 /* bytes in buf */
+};
+
+struct worker
+{
+    pthread_t thread;
+    const char *path;
+    double interval;            /* seconds between requests, 0: closed loop */
+    double duration;
+    unsigned seed;
+
+    double *latency;            /* seconds */
+    size_t n, cap;
+    long errors;
+};
+
+/* site \t user of every account, "GET\t" in front and "\n" at the end */
+static char **requests;
+static int nrequests;
+
+static double now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec*1e-9;
+}
+
+static int conn_open(struct conn *c, const char *path)
+{
+    struct sockaddr_un a;
+
+    memset(&a, 0, sizeof(a));
+    a.sun_family = AF_UNIX;
+    if(strlen(path) >= sizeof(a.sun_path)) return 0;
+    strcpy(a.sun_path, path);
+
+    c->len = 0;
+    c->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(c->fd < 0) return 0;
+    if(connect(c->fd, (struct sockaddr *)&a, sizeof(a)) != 0)
+    {
+        close(c->fd);
+        return 0;
+    }
+    return 1;
+}
+
+static int conn_send(struct conn *c, const char *s)
+{
+    size_t len = strlen(s);
+
+    while(len)
+    {
+        ssize_t n = write(c->fd, s, len);
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0) return 0;
+        s += n;
+        len -= n;
+    }
+    return 1;
+}
+
+/* Next line into line (without the newline), returns 0 on EOF/error */
+static int conn_line(struct conn *c, char *line, size_t size)
+{
+    for(;;)
+    {
+        char *nl = memchr(c->buf, '\n', c->len);
+        if(nl)
+        {
+            size_t l = nl - c->buf;
+            if(l >= size) l = size-1;
+            memcpy(line, c->buf, l);
+            line[l] = 0;
+            c->len -= nl+1 - c->buf;
+            memmove(c->buf, nl+1, c->len);
+            return 1;
+        }
+
+        if(c->len == sizeof(c->buf)) return 0;
+
+        ssize_t n = read(c->fd, c->buf + c->len, sizeof(c->buf) - c->len);
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0) return 0;
+        c->len += n;
+    }
+}
+
+static void *work(void *arg)
+{
+    struct worker *w = (struct worker *)arg;
+    struct conn *c = (struct conn *)malloc(sizeof(struct conn));
+    char line[1024];
+    double start = now(), next = start;
+
+    if(c == NULL || !conn_open(c, w->path))
+    {
+        w->errors++;
+        free(c);
+        return NULL;
+    }
+
+    while(now() - start < w->duration)
+    {
+        double t;
+
+        if(w->interval > 0)
+        {
+            // send on schedule, measure from there
+            while((t = now()) < next)
+            {
+                double d = next - t;
+                struct timespec ts = { (time_t)d, (long)((d - (time_t)d)*1e9) };
+                nanosleep(&ts, NULL);
+            }
+            t = next;
+            next += w->interval;
+        }
+         else
+            t = now();
+
+        if(!conn_send(c, requests[rand_r(&w->seed) % nrequests]) ||
+           !conn_line(c, line, sizeof(line)))
+        {
+            w->errors++;
+            break;
+        }
+
+        if(strncmp(line, "ok\t", 3) != 0) w->errors++;
+
+        if(w->n == w->cap)
+        {
+            /* keep what was measured if there is no more memory */
+            size_t cap = w->cap ? 2*w->cap : 4096;
+            double *latency = (double *)realloc(w->latency, cap*sizeof(double));
+            if(latency == NULL)
+            {
+                w->errors++;
+                break;
+            }
+            w->latency = latency;
+            w->cap = cap;
+        }
+        w->latency[w->n++] = now() - t;
+    }
+
+    close(c->fd);
+    free(c);
+    return NULL;
+}
+
+/* Ask for the accounts that match phrase and fill requests */
+static int find_accounts(const char *path, const char *phrase)
+{
+    struct conn c;
+    char line[1024];
+    int i;
+
+    if(!conn_open(&c, path)) return 0;
+
+    snprintf(line, sizeof(line), "FIND\t%s\n", phrase);
+    if(!conn_send(&c, line) || !conn_line(&c, line, sizeof(line)) ||
+       strncmp(line, "ok\t", 3) != 0)
+    {
+        close(c.fd);
+        return 0;
+    }
+
+    nrequests = atoi(line+3);
+    requests = (char **)calloc(nrequests ? nrequests : 1, sizeof(char *));
+    for(i = 0; i < nrequests && requests; ++i)
+    {
+        if(!conn_line(&c, line, sizeof(line)) ||
+           (requests[i] = (char *)malloc(strlen(line) + 6)) == NULL)
+            break;
+        sprintf(requests[i], "GET\t%s\n", line);
+    }
+    nrequests = i;
+
+    close(c.fd);
+    return 1;
+}
+
+static void print_stats(const char *path)
+{
+    struct conn c;
+    char line[65536];
+
+    if(conn_open(&c, path))
+    {
+        if(conn_send(&c, "STATS\n") && conn_line(&c, line, sizeof(line)))
+            printf("server: %s\n", line);
+        close(c.fd);
+    }
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "Usage: qhashpwd_load [options]\n"
+            "  -s PATH     socket of qhashpwd (default: ~/.qhashpwd.sock)\n"
+            "  -c N        connections (default 8)\n"
+            "  -d SECONDS  duration (default 10)\n"
+            "  -r RATE     requests per second in total (default: as fast as possible)\n"
+            "  -f PHRASE   only accounts that match PHRASE (default: all)\n");
+}
+
+int main(int argc, char *argv[])
+{
+    char defpath[4096];
+    const char *path = NULL, *phrase = "";
+    int nconn = 8, opt, i;
+    double duration = 10, rate = 0, elapsed;
+    struct worker *w;
+    double *all;
+    size_t total = 0;
+    long errors = 0;
+
+    while((opt = getopt(argc, argv, "s:c:d:r:f:h")) != -1)
+    {
+        switch(opt)
+        {
+        case 's': path = optarg; break;
+        case 'c': nconn = atoi(optarg); break;
+        case 'd': duration = atof(optarg); break;
+        case 'r': rate = atof(optarg); break;
+        case 'f': phrase = optarg; break;
+        default: usage(); return opt == 'h' ? 0 : 2;
+        }
+    }
+
+    if(path == NULL)
+    {
+        snprintf(defpath, sizeof(defpath), "%s/.qhashpwd.sock", getenv("HOME") ? getenv("HOME") : ".");
+        path = defpath;
+    }
+
+    if(nconn < 1 || duration <= 0 || rate < 0)
+    {
+        usage();
+        return 2;
+    }
+
+    if(!find_accounts(path, phrase) || nrequests == 0)
+    {
+        fprintf(stderr, "qhashpwd_load: no accounts from %s\n", path);
+        return 2;
+    }
+
+    w = (struct worker *)calloc(nconn, sizeof(struct worker));
+    if(w == NULL) return 2;
+
+    elapsed = now();
+    for(i = 0; i < nconn; ++i)
+    {
+        w[i].path = path;
+        w[i].interval = rate > 0 ? nconn/rate : 0;
+        w[i].duration = duration;
+        w[i].seed = 12345 + i;
+        if(pthread_create(&w[i].thread, NULL, work, &w[i]) != 0)
+        {
+            fprintf(stderr, "qhashpwd_load: cannot create threads\n");
+            return 2;
+        }
+    }
+    for(i = 0; i < nconn; ++i)
+    {
+        pthread_join(w[i].thread, NULL);
+        total += w[i].n;
+        errors += w[i].errors;
+    }
+    elapsed = now() - elapsed;
+
+    all = (double *)malloc((total ? total : 1)*sizeof(double));
+    if(all == NULL) return 2;
+    for(i = 0, total = 0; i < nconn; ++i)
+    {
+        if(w[i].n) memcpy(all + total, w[i].latency, w[i].n*sizeof(double));
+        total += w[i].n;
+        free(w[i].latency);
+    }
+    qsort(all, total, sizeof(double), cmp_double);
+
+    printf("%lu requests in %.2f s (%.0f/s), %ld errors, %d accounts, %d connections\n",
+           (unsigned long)total, elapsed, total/elapsed, errors, nrequests, nconn);
+    if(total)
+        printf("latency: p50=%.1fus p90=%.1fus p99=%.1fus p99.9=%.1fus max=%.1fus\n",
+               all[total/2]*1e6, all[total*9/10]*1e6, all[total*99/100]*1e6,
+               all[total*999/1000]*1e6, all[total-1]*1e6);
+    print_stats(path);
+
+    free(all);
+    free(w);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,10 @@
+# -------------------------------------------------
+# Load generator for qhashpwd (no Qt needed).
+# Build with qmake qhashpwd_load.pro && make
+# -------------------------------------------------
+TARGET = qhashpwd_load
+TEMPLATE = app
+CONFIG += console
+CONFIG -= qt app_bundle
+SOURCES += qhashpwd_load.c
+LIBS += -lpthread -lrt
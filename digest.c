@@ -0,0 +1,455 @@
+/*
+ * Copyright 2010 (c) Sascha Mueller <mailbox@saschamueller.com>
+ *
+ * This file is part of qhashpw.
+ *
+ * qhashpw is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * qhashpw is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with qhashpw.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <string.h>
+
+#include "digest.h"
+#include "hashpw.h"
+
+/* scalar instances of the compression functions */
+#define DIGEST_VEC      uint32_t
+#define DIGEST_FN(name) compress_##name
+#define DIGEST_ATTR
+#include "digest_rounds.h"
+#undef DIGEST_VEC
+#undef DIGEST_FN
+#undef DIGEST_ATTR
+
+/*******************************************************************/
+/** SHA-512 and BLAKE2b                                           **/
+
+#define ROR64(x, n)     (((x) >> (n)) | ((x) << (64-(n))))
+
+/* also the IV of BLAKE2b */
+static const uint64_t sha512_iv[8] =
+{
+    UINT64_C(0x6a09e667f3bcc908), UINT64_C(0xbb67ae8584caa73b),
+    UINT64_C(0x3c6ef372fe94f82b), UINT64_C(0xa54ff53a5f1d36f1),
+    UINT64_C(0x510e527fade682d1), UINT64_C(0x9b05688c2b3e6c1f),
+    UINT64_C(0x1f83d9abfb41bd6b), UINT64_C(0x5be0cd19137e2179)
+};
+
+static const uint64_t sha512_k[80] =
+{
+    UINT64_C(0x428a2f98d728ae22), UINT64_C(0x7137449123ef65cd), UINT64_C(0xb5c0fbcfec4d3b2f), UINT64_C(0xe9b5dba58189dbbc),
+    UINT64_C(0x3956c25bf348b538), UINT64_C(0x59f111f1b605d019), UINT64_C(0x923f82a4af194f9b), UINT64_C(0xab1c5ed5da6d8118),
+    UINT64_C(0xd807aa98a3030242), UINT64_C(0x12835b0145706fbe), UINT64_C(0x243185be4ee4b28c), UINT64_C(0x550c7dc3d5ffb4e2),
+    UINT64_C(0x72be5d74f27b896f), UINT64_C(0x80deb1fe3b1696b1), UINT64_C(0x9bdc06a725c71235), UINT64_C(0xc19bf174cf692694),
+    UINT64_C(0xe49b69c19ef14ad2), UINT64_C(0xefbe4786384f25e3), UINT64_C(0x0fc19dc68b8cd5b5), UINT64_C(0x240ca1cc77ac9c65),
+    UINT64_C(0x2de92c6f592b0275), UINT64_C(0x4a7484aa6ea6e483), UINT64_C(0x5cb0a9dcbd41fbd4), UINT64_C(0x76f988da831153b5),
+    UINT64_C(0x983e5152ee66dfab), UINT64_C(0xa831c66d2db43210), UINT64_C(0xb00327c898fb213f), UINT64_C(0xbf597fc7beef0ee4),
+    UINT64_C(0xc6e00bf33da88fc2), UINT64_C(0xd5a79147930aa725), UINT64_C(0x06ca6351e003826f), UINT64_C(0x142929670a0e6e70),
+    UINT64_C(0x27b70a8546d22ffc), UINT64_C(0x2e1b21385c26c926), UINT64_C(0x4d2c6dfc5ac42aed), UINT64_C(0x53380d139d95b3df),
+    UINT64_C(0x650a73548baf63de), UINT64_C(0x766a0abb3c77b2a8), UINT64_C(0x81c2c92e47edaee6), UINT64_C(0x92722c851482353b),
+    UINT64_C(0xa2bfe8a14cf10364), UINT64_C(0xa81a664bbc423001), UINT64_C(0xc24b8b70d0f89791), UINT64_C(0xc76c51a30654be30),
+    UINT64_C(0xd192e819d6ef5218), UINT64_C(0xd69906245565a910), UINT64_C(0xf40e35855771202a), UINT64_C(0x106aa07032bbd1b8),
+    UINT64_C(0x19a4c116b8d2d0c8), UINT64_C(0x1e376c085141ab53), UINT64_C(0x2748774cdf8eeb99), UINT64_C(0x34b0bcb5e19b48a8),
+    UINT64_C(0x391c0cb3c5c95a63), UINT64_C(0x4ed8aa4ae3418acb), UINT64_C(0x5b9cca4f7763e373), UINT64_C(0x682e6ff3d6b2b8a3),
+    UINT64_C(0x748f82ee5defb2fc), UINT64_C(0x78a5636f43172f60), UINT64_C(0x84c87814a1f0ab72), UINT64_C(0x8cc702081a6439ec),
+    UINT64_C(0x90befffa23631e28), UINT64_C(0xa4506cebde82bde9), UINT64_C(0xbef9a3f7b2c67915), UINT64_C(0xc67178f2e372532b),
+    UINT64_C(0xca273eceea26619c), UINT64_C(0xd186b8c721c0c207), UINT64_C(0xeada7dd6cde0eb1e), UINT64_C(0xf57d4f7fee6ed178),
+    UINT64_C(0x06f067aa72176fba), UINT64_C(0x0a637dc5a2c898a6), UINT64_C(0x113f9804bef90dae), UINT64_C(0x1b710b35131c471b),
+    UINT64_C(0x28db77f523047d84), UINT64_C(0x32caab7b40c72493), UINT64_C(0x3c9ebe0a15c9bebc), UINT64_C(0x431d67c49c100d4c),
+    UINT64_C(0x4cc5d4becb3e42b6), UINT64_C(0x597f299cfc657e2a), UINT64_C(0x5fcb6fab3ad6faec), UINT64_C(0x6c44198c4a475817)
+};
+
+static const unsigned char blake2b_sigma[12][16] =
+{
+    {  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 },
+    { 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 },
+    { 11,  8, 12,  0,  5,  2, 15, 13, 10, 14,  3,  6,  7,  1,  9,  4 },
+    {  7,  9,  3,  1, 13, 12, 11, 14,  2,  6,  5, 10,  4,  0, 15,  8 },
+    {  9,  0,  5,  7,  2,  4, 10, 15, 14,  1, 11, 12,  6,  8,  3, 13 },
+    {  2, 12,  6, 10,  0, 11,  8,  3,  4, 13,  7,  5, 15, 14,  1,  9 },
+    { 12,  5,  1, 15, 14, 13,  4, 10,  0,  7,  6,  3,  9,  2,  8, 11 },
+    { 13, 11,  7, 14, 12,  1,  3,  9,  5,  0, 15,  4,  8,  6,  2, 10 },
+    {  6, 15, 14,  9, 11,  3,  0,  8, 12,  2, 13,  7,  1,  4, 10,  5 },
+    { 10,  2,  8,  4,  7,  6,  1,  5, 15, 11,  9, 14,  3, 12, 13,  0 },
+    {  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 },
+    { 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 }
+};
+
+static uint64_t load64_be(const unsigned char *p)
+{
+    uint64_t x = 0;
+    int i;
+
+    for(i = 0; i < 8; ++i) x = x << 8 | p[i];
+    return x;
+}
+
+static uint64_t load64_le(const unsigned char *p)
+{
+    uint64_t x = 0;
+    int i;
+
+    for(i = 7; i >= 0; --i) x = x << 8 | p[i];
+    return x;
+}
+
+static void compress_sha512(uint64_t *h, const unsigned char *block)
+{
+    uint64_t w[16];
+    uint64_t a = h[0], b = h[1], c = h[2], d = h[3];
+    uint64_t e = h[4], f = h[5], g = h[6], hh = h[7];
+    uint64_t t1, t2;
+    int i;
+
+    for(i = 0; i < 16; ++i) w[i] = load64_be(block + 8*i);
+
+#define SHA512_S0(x)    (ROR64(x, 28) ^ ROR64(x, 34) ^ ROR64(x, 39))
+#define SHA512_S1(x)    (ROR64(x, 14) ^ ROR64(x, 18) ^ ROR64(x, 41))
+#define SHA512_s0(x)    (ROR64(x, 1) ^ ROR64(x, 8) ^ ((x) >> 7))
+#define SHA512_s1(x)    (ROR64(x, 19) ^ ROR64(x, 61) ^ ((x) >> 6))
+
+    for(i = 0; i < 80; ++i)
+    {
+        // ring of 16 words as in SHA-256
+        if(i >= 16)
+            w[i&15] += SHA512_s1(w[(i-2)&15]) + w[(i-7)&15] + SHA512_s0(w[(i-15)&15]);
+
+        t1 = hh + SHA512_S1(e) + (g ^ (e & (f ^ g))) + sha512_k[i] + w[i&15];
+        t2 = SHA512_S0(a) + ((a & b) | (c & (a | b)));
+        hh = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+
+#undef SHA512_S0
+#undef SHA512_S1
+#undef SHA512_s0
+#undef SHA512_s1
+
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+    h[5] += f;
+    h[6] += g;
+    h[7] += hh;
+}
+
+/* t is the number of bytes hashed including this block */
+static void compress_blake2b(uint64_t *h, const unsigned char *block, uint64_t t, int last)
+{
+    uint64_t m[16], v[16];
+    int i, r;
+
+    for(i = 0; i < 16; ++i) m[i] = load64_le(block + 8*i);
+    for(i = 0; i < 8; ++i)
+    {
+        v[i] = h[i];
+        v[i+8] = sha512_iv[i];
+    }
+    v[12] ^= t;         // the upper half of the 128 bit counter stays 0
+    if(last) v[14] = ~v[14];
+
+#define BLAKE2B_G(a, b, c, d, x, y) \
+    v[a] += v[b] + (x); v[d] = ROR64(v[d] ^ v[a], 32); \
+    v[c] += v[d];       v[b] = ROR64(v[b] ^ v[c], 24); \
+    v[a] += v[b] + (y); v[d] = ROR64(v[d] ^ v[a], 16); \
+    v[c] += v[d];       v[b] = ROR64(v[b] ^ v[c], 63)
+
+    for(r = 0; r < 12; ++r)
+    {
+        const unsigned char *s = blake2b_sigma[r];
+
+        BLAKE2B_G(0, 4,  8, 12, m[s[0]],  m[s[1]]);
+        BLAKE2B_G(1, 5,  9, 13, m[s[2]],  m[s[3]]);
+        BLAKE2B_G(2, 6, 10, 14, m[s[4]],  m[s[5]]);
+        BLAKE2B_G(3, 7, 11, 15, m[s[6]],  m[s[7]]);
+        BLAKE2B_G(0, 5, 10, 15, m[s[8]],  m[s[9]]);
+        BLAKE2B_G(1, 6, 11, 12, m[s[10]], m[s[11]]);
+        BLAKE2B_G(2, 7,  8, 13, m[s[12]], m[s[13]]);
+        BLAKE2B_G(3, 4,  9, 14, m[s[14]], m[s[15]]);
+    }
+
+#undef BLAKE2B_G
+
+    for(i = 0; i < 8; ++i) h[i] ^= v[i] ^ v[i+8];
+}
+
+/*******************************************************************/
+
+int digest_supported(int hash)
+{
+    switch(hash)
+    {
+    case HASH_RIPEMD160:
+    case HASH_SHA1:
+    case HASH_DSS1:     /* same digest as SHA-1 */
+    case HASH_MD5:
+    case HASH_SHA256:
+    case HASH_SHA512:
+    case HASH_BLAKE2B:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+unsigned int digest_size(int hash)
+{
+    switch(hash)
+    {
+    case HASH_RIPEMD160:
+    case HASH_SHA1:
+    case HASH_DSS1:     return 20;
+    case HASH_MD5:      return 16;
+    case HASH_SHA256:   return 32;
+    case HASH_SHA512:
+    case HASH_BLAKE2B:  return 64;
+    default:            return 0;
+    }
+}
+
+unsigned int digest_block_size(int hash)
+{
+    return digest_wide(hash) ? 128 : 64;
+}
+
+int digest_wide(int hash)
+{
+    return hash == HASH_SHA512 || hash == HASH_BLAKE2B;
+}
+
+int digest_big_endian(int hash)
+{
+    return hash == HASH_SHA1 || hash == HASH_DSS1 || hash == HASH_SHA256 || hash == HASH_SHA512;
+}
+
+void digest_init(struct digest_ctx *c, int hash)
+{
+    assert(digest_supported(hash));
+
+    c->hash = hash;
+    c->buflen = 0;
+    c->total = 0;
+
+    switch(hash)
+    {
+    case HASH_SHA256:
+        c->h[0] = 0x6a09e667;
+        c->h[1] = 0xbb67ae85;
+        c->h[2] = 0x3c6ef372;
+        c->h[3] = 0xa54ff53a;
+        c->h[4] = 0x510e527f;
+        c->h[5] = 0x9b05688c;
+        c->h[6] = 0x1f83d9ab;
+        c->h[7] = 0x5be0cd19;
+        break;
+    case HASH_SHA512:
+        memcpy(c->h64, sha512_iv, sizeof(c->h64));
+        break;
+    case HASH_BLAKE2B:
+        memcpy(c->h64, sha512_iv, sizeof(c->h64));
+        c->h64[0] ^= 0x01010000 | DIGEST_MAX_SIZE;     // no key, 64 byte digest
+        break;
+    default:
+        c->h[0] = 0x67452301;
+        c->h[1] = 0xefcdab89;
+        c->h[2] = 0x98badcfe;
+        c->h[3] = 0x10325476;
+        c->h[4] = 0xc3d2e1f0;   /* not used by MD5 */
+    }
+}
+
+void digest_compress(int hash, uint32_t *h, const uint32_t *w)
+{
+    switch(hash)
+    {
+    case HASH_RIPEMD160:    compress_ripemd160(h, w); break;
+    case HASH_SHA1:
+    case HASH_DSS1:         compress_sha1(h, w); break;
+    case HASH_MD5:          compress_md5(h, w); break;
+    case HASH_SHA256:       compress_sha256(h, w); break;
+    default:                assert(0);
+    }
+}
+
+void digest_load_block(int hash, const unsigned char *block, uint32_t *w)
+{
+    int i;
+
+    if(digest_big_endian(hash))
+        for(i = 0; i < 16; ++i, block += 4)
+            w[i] = (uint32_t)block[0] << 24 | (uint32_t)block[1] << 16 |
+                   (uint32_t)block[2] << 8 | block[3];
+    else
+        for(i = 0; i < 16; ++i, block += 4)
+            w[i] = (uint32_t)block[3] << 24 | (uint32_t)block[2] << 16 |
+                   (uint32_t)block[1] << 8 | block[0];
+}
+
+void digest_store(int hash, const uint32_t *h, unsigned char *out)
+{
+    unsigned int i;
+    int be = digest_big_endian(hash);
+
+    for(i = 0; i < digest_size(hash)/4; ++i, out += 4)
+    {
+        uint32_t x = h[i];
+        if(be)
+        {
+            out[0] = x >> 24; out[1] = x >> 16; out[2] = x >> 8; out[3] = x;
+        }
+         else
+        {
+            out[0] = x; out[1] = x >> 8; out[2] = x >> 16; out[3] = x >> 24;
+        }
+    }
+}
+
+/* c->total already counts the block. BLAKE2b blocks that reach this are
+ * never the last one */
+static void compress_bytes(struct digest_ctx *c, const unsigned char *block)
+{
+    uint32_t w[16];
+
+    switch(c->hash)
+    {
+    case HASH_SHA512:
+        compress_sha512(c->h64, block);
+        break;
+    case HASH_BLAKE2B:
+        compress_blake2b(c->h64, block, c->total, 0);
+        break;
+    default:
+        digest_load_block(c->hash, block, w);
+        digest_compress(c->hash, c->h, w);
+    }
+}
+
+/* BLAKE2b has to keep the last block, even a full one, for digest_final */
+static void update_blake2b(struct digest_ctx *c, const unsigned char *p, size_t len)
+{
+    while(len)
+    {
+        size_t n;
+
+        if(c->buflen == DIGEST_MAX_BLOCK_SIZE)
+        {
+            compress_bytes(c, c->buf);
+            c->buflen = 0;
+        }
+
+        n = DIGEST_MAX_BLOCK_SIZE - c->buflen;
+        if(n > len) n = len;
+        memcpy(c->buf + c->buflen, p, n);
+        c->buflen += n;
+        c->total += n;
+        p += n;
+        len -= n;
+    }
+}
+
+void digest_update(struct digest_ctx *c, const void *data, size_t len)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    size_t bs = digest_block_size(c->hash);
+
+    if(c->hash == HASH_BLAKE2B)
+    {
+        update_blake2b(c, p, len);
+        return;
+    }
+
+    c->total += len;
+
+    if(c->buflen)
+    {
+        size_t n = bs - c->buflen;
+        if(n > len) n = len;
+        memcpy(c->buf + c->buflen, p, n);
+        c->buflen += n;
+        p += n;
+        len -= n;
+        if(c->buflen < bs) return;
+        compress_bytes(c, c->buf);
+        c->buflen = 0;
+    }
+
+    for(; len >= bs; p += bs, len -= bs)
+        compress_bytes(c, p);
+
+    memcpy(c->buf, p, len);
+    c->buflen = len;
+}
+
+void digest_absorb_block(struct digest_ctx *c, const unsigned char *block)
+{
+    assert(c->buflen == 0);
+
+    c->total += digest_block_size(c->hash);
+    compress_bytes(c, block);
+}
+
+static void store64(uint64_t x, int big_endian, unsigned char *out)
+{
+    int i;
+
+    for(i = 0; i < 8; ++i)
+        out[big_endian ? 7-i : i] = (unsigned char)(x >> (8*i));
+}
+
+unsigned int digest_final(struct digest_ctx *c, unsigned char *out)
+{
+    uint64_t bits = c->total * 8;
+    unsigned int bs = digest_block_size(c->hash);
+    /* SHA-512 has a 128 bit length, of which the upper half stays 0 */
+    unsigned int lenbytes = c->hash == HASH_SHA512 ? 16 : 8;
+    int i;
+
+    if(c->hash == HASH_BLAKE2B)
+    {
+        memset(c->buf + c->buflen, 0, bs - c->buflen);
+        compress_blake2b(c->h64, c->buf, c->total, 1);
+        for(i = 0; i < 8; ++i) store64(c->h64[i], 0, out + 8*i);
+        return digest_size(c->hash);
+    }
+
+    /* 0x80, zeros up to lenbytes before a block boundary, length */
+    c->buf[c->buflen++] = 0x80;
+    if(c->buflen > bs-lenbytes)
+    {
+        memset(c->buf + c->buflen, 0, bs - c->buflen);
+        compress_bytes(c, c->buf);
+        c->buflen = 0;
+    }
+    memset(c->buf + c->buflen, 0, bs-8 - c->buflen);
+
+    for(i = 0; i < 8; ++i)
+    {
+        if(digest_big_endian(c->hash))
+            c->buf[bs-1-i] = (unsigned char)(bits >> (8*i));
+        else
+            c->buf[bs-8+i] = (unsigned char)(bits >> (8*i));
+    }
+    compress_bytes(c, c->buf);
+
+    if(c->hash == HASH_SHA512)
+    {
+        for(i = 0; i < 8; ++i) store64(c->h64[i], 1, out + 8*i);
+        return digest_size(c->hash);
+    }
+
+    digest_store(c->hash, c->h, out);
+    return digest_size(c->hash);
+}
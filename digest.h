@@ -0,0 +1,94 @@
+/*
+ * Copyright 2010 (c) Sascha Mueller <mailbox@saschamueller.com>
+ *
+ * This file is part of qhashpw.
+ *
+ * qhashpw is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * qhashpw is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with qhashpw.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DIGEST_H
+#define DIGEST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* In-tree implementations of the hash algorithms (HASH_ constants of
+ * hashpw.h) that do not need OpenSSL and that give access to their
+ * chaining values, which the multi-buffer HMAC (hmac_mb.h) is built on.
+ *
+ * SHA-512 and BLAKE2b ("wide" hashes) work on 64 bit words and 128 byte
+ * blocks. Only digest_init/update/final are available for them, the
+ * word and block functions below are for the 32 bit hashes. */
+
+#define DIGEST_MAX_SIZE         64      /* bytes of the largest digest */
+#define DIGEST_MAX_WORDS        8       /* words of the largest 32 bit chaining value */
+#define DIGEST_BLOCK_SIZE       64      /* bytes per compression of the 32 bit hashes */
+#define DIGEST_MAX_BLOCK_SIZE   128     /* bytes per compression of any hash */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct digest_ctx
+{
+    int hash;
+    uint32_t h[DIGEST_MAX_WORDS];           /* chaining value */
+    uint64_t h64[8];                        /* chaining value of the wide hashes */
+    unsigned char buf[DIGEST_MAX_BLOCK_SIZE];   /* incomplete block */
+    unsigned int buflen;
+    uint64_t total;                         /* bytes hashed so far */
+};
+
+/* returns 0 if hash has no in-tree implementation */
+int digest_supported(int hash);
+
+/* size of the digest in bytes */
+unsigned int digest_size(int hash);
+
+/* bytes per compression */
+unsigned int digest_block_size(int hash);
+
+/* 1 for SHA-512 and BLAKE2b */
+int digest_wide(int hash);
+
+/* 1 if the message and digest words of hash are big endian */
+int digest_big_endian(int hash);
+
+void digest_init(struct digest_ctx *c, int hash);
+void digest_update(struct digest_ctx *c, const void *data, size_t len);
+
+/* Hash a whole block (digest_block_size bytes) at a block boundary,
+ * knowing that more data follows. Unlike digest_update, this compresses
+ * the block right away even for BLAKE2b (which otherwise has to keep the
+ * last block until digest_final), so a copy of c is a complete midstate.
+ * Hashing no more data after it gives a wrong BLAKE2b digest. */
+void digest_absorb_block(struct digest_ctx *c, const unsigned char *block);
+
+/* writes digest_size(c->hash) bytes to out and returns that size */
+unsigned int digest_final(struct digest_ctx *c, unsigned char *out);
+
+/* Compress the block of 16 words w (host byte order) into the
+ * chaining value h */
+void digest_compress(int hash, uint32_t *h, const uint32_t *w);
+
+/* Convert a block of bytes to words resp. a chaining value to bytes,
+ * respecting the byte order of hash */
+void digest_load_block(int hash, const unsigned char *block, uint32_t *w);
+void digest_store(int hash, const uint32_t *h, unsigned char *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DIGEST_H
@@ -0,0 +1,252 @@
+/*
+ * Copyright 2010 (c) Sascha Mueller <mailbox@saschamueller.com>
+ *
+ * This file is part of qhashpw.
+ *
+ * qhashpw is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * qhashpw is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with qhashpw.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Compression functions of MD5, SHA-1, RIPEMD-160 and SHA-256.
+ *
+ * This file has no include guard on purpose: it is included once by
+ * digest.c for plain 32 bit words, and once per vector width by
+ * hmac_mb.c, where every lane of a vector belongs to another message.
+ * Define before including:
+ *   DIGEST_VEC        word type (uint32_t or a GCC vector of uint32_t)
+ *   DIGEST_FN(name)   name of this instance of function name
+ *   DIGEST_ATTR       function attributes (e.g. the target instruction set)
+ *
+ * Every function takes the chaining values h and the 16 words w of one
+ * message block, already converted to host byte order.
+ */
+
+#ifndef DIGEST_ROUNDS_TABLES
+#define DIGEST_ROUNDS_TABLES
+
+#include <stdint.h>
+
+#define DIGEST_ROL(x, n)   (((x) << (n)) | ((x) >> (32-(n))))
+
+static const uint32_t md5_k[64] =
+{
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+
+static const unsigned char md5_s[4][4] =
+{
+    { 7, 12, 17, 22 }, { 5, 9, 14, 20 }, { 4, 11, 16, 23 }, { 6, 10, 15, 21 }
+};
+
+/* message word and rotation of every step, left and right line */
+static const unsigned char rmd_r[80] =
+{
+     0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15,
+     7,  4, 13,  1, 10,  6, 15,  3, 12,  0,  9,  5,  2, 14, 11,  8,
+     3, 10, 14,  4,  9, 15,  8,  1,  2,  7,  0,  6, 13, 11,  5, 12,
+     1,  9, 11, 10,  0,  8, 12,  4, 13,  3,  7, 15, 14,  5,  6,  2,
+     4,  0,  5,  9,  7, 12,  2, 10, 14,  1,  3,  8, 11,  6, 15, 13
+};
+
+static const unsigned char rmd_rp[80] =
+{
+     5, 14,  7,  0,  9,  2, 11,  4, 13,  6, 15,  8,  1, 10,  3, 12,
+     6, 11,  3,  7,  0, 13,  5, 10, 14, 15,  8, 12,  4,  9,  1,  2,
+    15,  5,  1,  3,  7, 14,  6,  9, 11,  8, 12,  2, 10,  0,  4, 13,
+     8,  6,  4,  1,  3, 11, 15,  0,  5, 12,  2, 13,  9,  7, 10, 14,
+    12, 15, 10,  4,  1,  5,  8,  7,  6,  2, 13, 14,  0,  3,  9, 11
+};
+
+static const unsigned char rmd_s[80] =
+{
+    11, 14, 15, 12,  5,  8,  7,  9, 11, 13, 14, 15,  6,  7,  9,  8,
+     7,  6,  8, 13, 11,  9,  7, 15,  7, 12, 15,  9, 11,  7, 13, 12,
+    11, 13,  6,  7, 14,  9, 13, 15, 14,  8, 13,  6,  5, 12,  7,  5,
+    11, 12, 14, 15, 14, 15,  9,  8,  9, 14,  5,  6,  8,  6,  5, 12,
+     9, 15,  5, 11,  6,  8, 13, 12,  5, 12, 13, 14, 11,  8,  5,  6
+};
+
+static const unsigned char rmd_sp[80] =
+{
+     8,  9,  9, 11, 13, 15, 15,  5,  7,  7,  8, 11, 14, 14, 12,  6,
+     9, 13, 15,  7, 12,  8,  9, 11,  7,  7, 12,  7,  6, 15, 13, 11,
+     9,  7, 15, 11,  8,  6,  6, 14, 12, 13,  5, 14, 13, 13,  7,  5,
+    15,  5,  8, 11, 14, 14,  6, 14,  6,  9, 12,  9, 12,  5, 15,  8,
+     8,  5, 12,  9, 12,  5, 14,  6,  8, 13,  6,  5, 15, 13, 11, 11
+};
+
+static const uint32_t sha256_k[64] =
+{
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#endif /* DIGEST_ROUNDS_TABLES */
+
+static DIGEST_ATTR void DIGEST_FN(md5)(DIGEST_VEC *h, const DIGEST_VEC *w)
+{
+    DIGEST_VEC a = h[0], b = h[1], c = h[2], d = h[3], t;
+    int i;
+
+#define MD5_STEP(f, g) \
+    t = b + DIGEST_ROL(a + (f) + md5_k[i] + w[g], md5_s[i>>4][i&3]); \
+    a = d; d = c; c = b; b = t
+
+    for(i = 0; i < 16; ++i) { MD5_STEP(d ^ (b & (c ^ d)), i); }
+    for(; i < 32; ++i)      { MD5_STEP(c ^ (d & (b ^ c)), (5*i+1) & 15); }
+    for(; i < 48; ++i)      { MD5_STEP(b ^ c ^ d, (3*i+5) & 15); }
+    for(; i < 64; ++i)      { MD5_STEP(c ^ (b | ~d), (7*i) & 15); }
+
+#undef MD5_STEP
+
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+}
+
+static DIGEST_ATTR void DIGEST_FN(sha1)(DIGEST_VEC *h, const DIGEST_VEC *win)
+{
+    DIGEST_VEC w[16];
+    DIGEST_VEC a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], t;
+    int i;
+
+    for(i = 0; i < 16; ++i) w[i] = win[i];
+
+    /* the message schedule is kept in a ring of 16 words */
+#define SHA1_SCHEDULE \
+    if(i >= 16) w[i&15] = DIGEST_ROL(w[(i-3)&15] ^ w[(i-8)&15] ^ w[(i-14)&15] ^ w[i&15], 1)
+#define SHA1_STEP(f, k) \
+    t = DIGEST_ROL(a, 5) + (f) + e + (uint32_t)(k) + w[i&15]; \
+    e = d; d = c; c = DIGEST_ROL(b, 30); b = a; a = t
+
+    for(i = 0; i < 20; ++i) { SHA1_SCHEDULE; SHA1_STEP(d ^ (b & (c ^ d)), 0x5a827999); }
+    for(; i < 40; ++i)      { SHA1_SCHEDULE; SHA1_STEP(b ^ c ^ d, 0x6ed9eba1); }
+    for(; i < 60; ++i)      { SHA1_SCHEDULE; SHA1_STEP((b & c) | (d & (b | c)), 0x8f1bbcdc); }
+    for(; i < 80; ++i)      { SHA1_SCHEDULE; SHA1_STEP(b ^ c ^ d, 0xca62c1d6); }
+
+#undef SHA1_SCHEDULE
+#undef SHA1_STEP
+
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+}
+
+static DIGEST_ATTR void DIGEST_FN(ripemd160)(DIGEST_VEC *h, const DIGEST_VEC *w)
+{
+    DIGEST_VEC al = h[0], bl = h[1], cl = h[2], dl = h[3], el = h[4];
+    DIGEST_VEC ar = h[0], br = h[1], cr = h[2], dr = h[3], er = h[4];
+    DIGEST_VEC t;
+    int i;
+
+    /* One step of both lines; fl/fr are the boolean functions of the
+     * current round for the left resp. right line */
+#define RMD_STEP(fl, kl, fr, kr) \
+    t = DIGEST_ROL(al + (fl) + w[rmd_r[i]] + (uint32_t)(kl), rmd_s[i]) + el; \
+    al = el; el = dl; dl = DIGEST_ROL(cl, 10); cl = bl; bl = t; \
+    t = DIGEST_ROL(ar + (fr) + w[rmd_rp[i]] + (uint32_t)(kr), rmd_sp[i]) + er; \
+    ar = er; er = dr; dr = DIGEST_ROL(cr, 10); cr = br; br = t
+
+#define RMD_F1(x, y, z) ((x) ^ (y) ^ (z))
+#define RMD_F2(x, y, z) (((x) & (y)) | (~(x) & (z)))
+#define RMD_F3(x, y, z) (((x) | ~(y)) ^ (z))
+#define RMD_F4(x, y, z) (((x) & (z)) | ((y) & ~(z)))
+#define RMD_F5(x, y, z) ((x) ^ ((y) | ~(z)))
+
+    for(i = 0; i < 16; ++i)
+    { RMD_STEP(RMD_F1(bl, cl, dl), 0x00000000, RMD_F5(br, cr, dr), 0x50a28be6); }
+    for(; i < 32; ++i)
+    { RMD_STEP(RMD_F2(bl, cl, dl), 0x5a827999, RMD_F4(br, cr, dr), 0x5c4dd124); }
+    for(; i < 48; ++i)
+    { RMD_STEP(RMD_F3(bl, cl, dl), 0x6ed9eba1, RMD_F3(br, cr, dr), 0x6d703ef3); }
+    for(; i < 64; ++i)
+    { RMD_STEP(RMD_F4(bl, cl, dl), 0x8f1bbcdc, RMD_F2(br, cr, dr), 0x7a6d76e9); }
+    for(; i < 80; ++i)
+    { RMD_STEP(RMD_F5(bl, cl, dl), 0xa953fd4e, RMD_F1(br, cr, dr), 0x00000000); }
+
+#undef RMD_STEP
+#undef RMD_F1
+#undef RMD_F2
+#undef RMD_F3
+#undef RMD_F4
+#undef RMD_F5
+
+    t = h[1] + cl + dr;
+    h[1] = h[2] + dl + er;
+    h[2] = h[3] + el + ar;
+    h[3] = h[4] + al + br;
+    h[4] = h[0] + bl + cr;
+    h[0] = t;
+}
+
+static DIGEST_ATTR void DIGEST_FN(sha256)(DIGEST_VEC *h, const DIGEST_VEC *win)
+{
+    DIGEST_VEC w[16];
+    DIGEST_VEC a = h[0], b = h[1], c = h[2], d = h[3];
+    DIGEST_VEC e = h[4], f = h[5], g = h[6], hh = h[7];
+    DIGEST_VEC t1, t2;
+    int i;
+
+    for(i = 0; i < 16; ++i) w[i] = win[i];
+
+#define SHA256_ROR(x, n)  DIGEST_ROL(x, 32-(n))
+#define SHA256_S0(x)      (SHA256_ROR(x, 2) ^ SHA256_ROR(x, 13) ^ SHA256_ROR(x, 22))
+#define SHA256_S1(x)      (SHA256_ROR(x, 6) ^ SHA256_ROR(x, 11) ^ SHA256_ROR(x, 25))
+#define SHA256_s0(x)      (SHA256_ROR(x, 7) ^ SHA256_ROR(x, 18) ^ ((x) >> 3))
+#define SHA256_s1(x)      (SHA256_ROR(x, 17) ^ SHA256_ROR(x, 19) ^ ((x) >> 10))
+
+    for(i = 0; i < 64; ++i)
+    {
+        /* the message schedule is kept in a ring of 16 words,
+         * w[i&15] still holds w[i-16] */
+        if(i >= 16)
+            w[i&15] += SHA256_s1(w[(i-2)&15]) + w[(i-7)&15] + SHA256_s0(w[(i-15)&15]);
+
+        t1 = hh + SHA256_S1(e) + (g ^ (e & (f ^ g))) + sha256_k[i] + w[i&15];
+        t2 = SHA256_S0(a) + ((a & b) | (c & (a | b)));
+        hh = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+
+#undef SHA256_ROR
+#undef SHA256_S0
+#undef SHA256_S1
+#undef SHA256_s0
+#undef SHA256_s1
+
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+    h[5] += f;
+    h[6] += g;
+    h[7] += hh;
+}
@@ -18,51 +18,479 @@
  */
 
 #include <assert.h>
-#include <ctype.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifndef HASHPW_NO_OPENSSL
+#include <openssl/evp.h>
 #include <openssl/hmac.h>
+#include <openssl/opensslv.h>
+#endif
 
+#if !defined(HASHPW_NO_THREADS) && !defined(HASHPW_NO_OPENSSL)
+#include <pthread.h>
+#endif
+
+#include "chacha20.h"
 #include "hashpw.h"
+#include "hashpw_internal.h"
+#include "hmac_mb.h"
+#include "secmem.h"
+
+/* Character class (FL_ constant) of every byte, so a byte is allowed
+ * if (charclass[b] & flags) != 0. This is islower/isupper/isdigit in the
+ * "C" locale, and for FL_SPECIAL the set of special characters
+ *   !"#$%&'()*+-./:;<=>?@[\]^_{|}~
+ * (note that ',' and '`' are not included). Bytes above 0x7f are never
+ * allowed. */
+#define L FL_LOWER
+#define U FL_UPPER
+#define D FL_DIGIT
+#define S FL_SPECIAL
+static const unsigned char charclass[256] =
+{
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  /* 0x00 */
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  /* 0x10 */
+    0, S, S, S, S, S, S, S, S, S, S, S, 0, S, S, S,  /* 0x20 */
+    D, D, D, D, D, D, D, D, D, D, S, S, S, S, S, S,  /* 0x30 */
+    S, U, U, U, U, U, U, U, U, U, U, U, U, U, U, U,  /* 0x40 */
+    U, U, U, U, U, U, U, U, U, U, U, S, S, S, S, S,  /* 0x50 */
+    0, L, L, L, L, L, L, L, L, L, L, L, L, L, L, L,  /* 0x60 */
+    L, L, L, L, L, L, L, L, L, L, L, S, S, S, S, 0,  /* 0x70 */
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  /* 0x80 */
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  /* 0x90 */
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  /* 0xa0 */
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  /* 0xb0 */
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  /* 0xc0 */
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  /* 0xd0 */
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  /* 0xe0 */
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  /* 0xf0 */
+};
+#undef L
+#undef U
+#undef D
+#undef S
+
+/*******************************************************************/
+/** Hash backends                                                 **/
+
+/* A backend computes the HMACs keyed with the main password. Whatever
+ * it derives from the main password is kept in the hashpw_key. */
+struct hashpw_backend
+{
+    const char *name;
+
+    /* Derive the state of hash from the main password.
+     * Returns 0 if hash is not supported or on failure */
+    int (*key_init)(struct hashpw_key *key, int hash, const char *mainPW, size_t len);
+
+    /* Free what key_init allocated (also after a failed key_init) */
+    void (*key_cleanup)(struct hashpw_key *key, int hash);
+
+    /* HMAC of n messages, the i-th result goes to out + i*outstride.
+     * Returns 0 on failure */
+    int (*hmac)(const struct hashpw_key *key, int hash, int n,
+                const unsigned char *const *msg, const size_t *len,
+                unsigned char *out, size_t outstride, unsigned int *outlen);
+
+    /* Number of messages hmac computes in about the time of one */
+    int (*lanes)(int hash);
+};
+
+struct hashpw_key
+{
+    const struct hashpw_backend *backend;   /* the one the key was created with */
+    int supported[MAX_HASH_VALUE+1];        /* hashes key_init succeeded for */
+
+    /* builtin: chaining values after the pad blocks */
+    struct hmac_mb_key mb[MAX_HASH_VALUE+1];
+
+#ifndef HASHPW_NO_OPENSSL
+    /* openssl: digest contexts that have already absorbed
+     * (mainPW ^ ipad) resp. (mainPW ^ opad), only ever copied */
+    EVP_MD_CTX *inner[MAX_HASH_VALUE+1];
+    EVP_MD_CTX *outer[MAX_HASH_VALUE+1];
+#endif
+};
+
+/* builtin backend: digest.h and the multi-buffer kernels of hmac_mb.h */
+
+static int builtin_key_init(struct hashpw_key *key, int hash, const char *mainPW, size_t len)
+{
+    return hmac_mb_key_init(&key->mb[hash], hash, mainPW, len);
+}
 
-/* maximum length of a string representation of an
- * integer. Used to determine a good size for snprintf
- * and for the maximum allowed size of integers for
- * the tokenizer*/
-#define MAX_INT_REP_LEN	(3*65)
+static void builtin_key_cleanup(struct hashpw_key *key, int hash)
+{
+    // the state is part of the key itself
+    (void)key;
+    (void)hash;
+}
 
-/* maximum allowed string length for input strings.
- * Only used for sanity checks */
-#define MAX_INPUT_LENGTH	1024
+static int builtin_hmac(const struct hashpw_key *key, int hash, int n,
+                        const unsigned char *const *msg, const size_t *len,
+                        unsigned char *out, size_t outstride, unsigned int *outlen)
+{
+    // the kernels only pay off with more than one lane in use
+    if(n == 1)
+        hmac_mb_one(&key->mb[hash], msg[0], len[0], out);
+    else
+        hmac_mb(&key->mb[hash], n, msg, len, out, outstride);
 
-/* Every value of PasswortOptions::hash less than
- * this value will be allowed */
-#define MAX_HASH_VALUE          3
+    *outlen = digest_size(hash);
+    return 1;
+}
+
+static int builtin_lanes(int hash)
+{
+    // the wide hashes have no kernels
+    return digest_wide(hash) ? 1 : hmac_mb_lanes();
+}
+
+static const struct hashpw_backend backend_builtin =
+{
+    "builtin", builtin_key_init, builtin_key_cleanup, builtin_hmac, builtin_lanes
+};
+
+#ifndef HASHPW_NO_OPENSSL
+
+/* openssl backend. DSS1 is SHA-1 with another signature algorithm,
+ * the digest (which is all we need) is the same.
+ *
+ * The key holds digest contexts that have absorbed (mainPW ^ ipad) resp.
+ * (mainPW ^ opad), and every HMAC copies them into a scratch context.
+ * This is about twice as fast as duplicating an initialized EVP_MAC_CTX
+ * for every block with OpenSSL 3. */
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+
+/* Implicit fetches (EVP_sha1() etc.) are expensive with OpenSSL 3, so
+ * every digest is fetched once. The fetched objects are immutable and
+ * may be used by every thread. */
+static EVP_MD *openssl_mds[MAX_HASH_VALUE+1];
+
+static void openssl_fetch(void)
+{
+    static const char *names[MAX_HASH_VALUE+1] =
+    {
+        "RIPEMD160", "SHA1", "SHA1", "MD5", "SHA256", "SHA512", "BLAKE2B-512"
+    };
+    int hash;
+
+    for(hash = 0; hash <= MAX_HASH_VALUE; ++hash)
+        openssl_mds[hash] = EVP_MD_fetch(NULL, names[hash], NULL);
+}
+
+#ifndef HASHPW_NO_THREADS
+static pthread_once_t openssl_once = PTHREAD_ONCE_INIT;
+#endif
 
 static const EVP_MD *get_evp_md_for_hash(int hash)
 {
-    assert(hash <= MAX_HASH_VALUE);
+#ifndef HASHPW_NO_THREADS
+    pthread_once(&openssl_once, openssl_fetch);
+#else
+    static int fetched = 0;
+    if(!fetched)
+    {
+        openssl_fetch();
+        fetched = 1;
+    }
+#endif
+    return openssl_mds[hash];
+}
 
+#else /* OpenSSL < 3 */
+
+static const EVP_MD *get_evp_md_for_hash(int hash)
+{
     switch(hash)
     {
     case HASH_RIPEMD160:  return EVP_ripemd160();
     case HASH_SHA1:       return EVP_sha1();
-    case HASH_DSS1:       return EVP_dss1();
+    case HASH_DSS1:       return EVP_sha1();
     case HASH_MD5:        return EVP_md5();
-    default:              return NULL;      /* Will never be reached */
+    case HASH_SHA256:     return EVP_sha256();
+    case HASH_SHA512:     return EVP_sha512();
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+    case HASH_BLAKE2B:    return EVP_blake2b512();
+#endif
+    default:              return NULL;      /* not available */
+    }
+}
+
+#endif /* OpenSSL < 3 */
+
+/* The scratch context of the calling thread, created on first use
+ * (and freed when the thread exits). Returns NULL if out of memory */
+#ifndef HASHPW_NO_THREADS
+static pthread_key_t openssl_work_key;
+static pthread_once_t openssl_work_once = PTHREAD_ONCE_INIT;
+
+static void openssl_work_free(void *work)
+{
+    EVP_MD_CTX_destroy((EVP_MD_CTX *)work);
+}
+
+static void openssl_work_init(void)
+{
+    pthread_key_create(&openssl_work_key, openssl_work_free);
+}
+
+static EVP_MD_CTX *openssl_work(void)
+{
+    EVP_MD_CTX *work;
+
+    pthread_once(&openssl_work_once, openssl_work_init);
+    work = (EVP_MD_CTX *)pthread_getspecific(openssl_work_key);
+    if(work == NULL)
+    {
+        work = EVP_MD_CTX_create();
+        if(work != NULL && pthread_setspecific(openssl_work_key, work) != 0)
+        {
+            EVP_MD_CTX_destroy(work);
+            work = NULL;
+        }
+    }
+    return work;
+}
+#else
+static EVP_MD_CTX *openssl_work(void)
+{
+    static EVP_MD_CTX *work = NULL;
+    if(work == NULL) work = EVP_MD_CTX_create();
+    return work;
+}
+#endif
+
+/* Derive the inner/outer states (the first half of RFC 2104) */
+static int openssl_key_init(struct hashpw_key *key, int hash, const char *mainPW, size_t len)
+{
+    const EVP_MD *md = get_evp_md_for_hash(hash);
+    unsigned char k[HMAC_MAX_MD_CBLOCK];
+    unsigned char pad[HMAC_MAX_MD_CBLOCK];
+    unsigned int klen;
+    int blocksize;
+    int i, ok;
+
+    if(md == NULL) return 0;
+
+    blocksize = EVP_MD_block_size(md);
+    assert(blocksize <= HMAC_MAX_MD_CBLOCK);
+
+    key->inner[hash] = EVP_MD_CTX_create();
+    key->outer[hash] = EVP_MD_CTX_create();
+    if(key->inner[hash] == NULL || key->outer[hash] == NULL) return 0;
+
+    /* keys longer than one block are hashed first */
+    if(len > (size_t)blocksize)
+    {
+        if(!EVP_DigestInit_ex(key->inner[hash], md, NULL) ||
+           !EVP_DigestUpdate(key->inner[hash], mainPW, len) ||
+           !EVP_DigestFinal_ex(key->inner[hash], k, &klen))
+            return 0;
+    }
+     else
+    {
+        memcpy(k, mainPW, len);
+        klen = len;
+    }
+    memset(k+klen, 0, blocksize-klen);
+
+    for(i = 0; i < blocksize; ++i) pad[i] = k[i]^0x36;
+    ok = EVP_DigestInit_ex(key->inner[hash], md, NULL) &&
+         EVP_DigestUpdate(key->inner[hash], pad, blocksize);
+
+    for(i = 0; i < blocksize; ++i) pad[i] = k[i]^0x5c;
+    ok = ok && EVP_DigestInit_ex(key->outer[hash], md, NULL) &&
+         EVP_DigestUpdate(key->outer[hash], pad, blocksize);
+
+    secmem_wipe(k, sizeof(k));
+    secmem_wipe(pad, sizeof(pad));
+
+    return ok;
+}
+
+static void openssl_key_cleanup(struct hashpw_key *key, int hash)
+{
+    if(key->inner[hash]) EVP_MD_CTX_destroy(key->inner[hash]);
+    if(key->outer[hash]) EVP_MD_CTX_destroy(key->outer[hash]);
+    key->inner[hash] = key->outer[hash] = NULL;
+}
+
+static int openssl_hmac(const struct hashpw_key *key, int hash, int n,
+                        const unsigned char *const *msg, const size_t *len,
+                        unsigned char *out, size_t outstride, unsigned int *outlen)
+{
+    unsigned char ihash[EVP_MAX_MD_SIZE];
+    unsigned int ilen;
+    EVP_MD_CTX *work = openssl_work();
+    int i, ok = work != NULL;
+
+    for(i = 0; i < n && ok; ++i)
+        ok = EVP_MD_CTX_copy_ex(work, key->inner[hash]) &&
+             EVP_DigestUpdate(work, msg[i], len[i]) &&
+             EVP_DigestFinal_ex(work, ihash, &ilen) &&
+             EVP_MD_CTX_copy_ex(work, key->outer[hash]) &&
+             EVP_DigestUpdate(work, ihash, ilen) &&
+             EVP_DigestFinal_ex(work, out + i*outstride, outlen);
+
+    return ok;
+}
+
+static int openssl_lanes(int hash)
+{
+    (void)hash;
+    return 1;
+}
+
+static const struct hashpw_backend backend_openssl =
+{
+    "openssl", openssl_key_init, openssl_key_cleanup, openssl_hmac, openssl_lanes
+};
+
+#endif /* HASHPW_NO_OPENSSL */
+
+static const struct hashpw_backend *const backends[] =
+{
+    &backend_builtin,
+#ifndef HASHPW_NO_OPENSSL
+    &backend_openssl,
+#endif
+    NULL
+};
+
+/* Backend of new keys. A race on this pointer is harmless,
+ * every thread sees one valid backend or the other */
+static const struct hashpw_backend *current_backend = &backend_builtin;
+
+int hashpw_backend_select(const char *name)
+{
+    int i;
+
+    if(name == NULL)
+    {
+        current_backend = &backend_builtin;
+        return 1;
     }
+
+    for(i = 0; backends[i]; ++i)
+        if(strcmp(backends[i]->name, name) == 0)
+        {
+            current_backend = backends[i];
+            return 1;
+        }
+
+    return 0;
 }
 
-/* A set of special characters */
-static const char *specialchars="!\"#$%&'()*+-./:;<=>?@[\\]^_{|}~";
+const char *hashpw_backend(void)
+{
+    return current_backend->name;
+}
+
+const char *hashpw_backend_name(int i)
+{
+    return i >= 0 && i < (int)(sizeof(backends)/sizeof(backends[0]))-1 ? backends[i]->name : NULL;
+}
+
+/*******************************************************************/
+/** Precomputed HMAC states                                       **/
+
+/* Derive the state for a single hash algorithm with the current backend.
+ * Returns 0 on failure (the key must be cleaned up anyway) */
+static int key_init_hash(struct hashpw_key *key, int hash, const char *mainPW, size_t len)
+{
+    key->backend = current_backend;
+    key->supported[hash] = key->backend->key_init(key, hash, mainPW, len);
+    return key->supported[hash];
+}
+
+static void key_cleanup(struct hashpw_key *key)
+{
+    int hash;
+
+    if(key->backend == NULL) return;
+
+    for(hash = 0; hash <= MAX_HASH_VALUE; ++hash)
+        key->backend->key_cleanup(key, hash);
+}
+
+int hashpw_key_hmac_many(const struct hashpw_key *key, int hash, int n,
+                         const unsigned char *const *msg, const size_t *len,
+                         unsigned char *out, size_t outstride, unsigned int *outlen)
+{
+    return key->supported[hash] &&
+           key->backend->hmac(key, hash, n, msg, len, out, outstride, outlen);
+}
+
+int hashpw_key_lanes(const struct hashpw_key *key, int hash)
+{
+    return key->backend->lanes(hash);
+}
+
+int hashpw_key_supports(const struct hashpw_key *key, int hash)
+{
+    return hash >= 0 && hash <= MAX_HASH_VALUE && key->supported[hash];
+}
+
+struct hashpw_key *hashpw_key_new(const char *mainPW)
+{
+    size_t len = strlen(mainPW);
+    int hash, any = 0;
+
+    if(len > MAX_INPUT_LENGTH) return NULL;
+
+    struct hashpw_key *key = (struct hashpw_key *)secmem_alloc(sizeof(struct hashpw_key));
+    if(key == NULL) return NULL;
+
+    /* An algorithm the backend does not support is reported
+     * as -4 when a password with it is created */
+    for(hash = 0; hash <= MAX_HASH_VALUE; ++hash)
+        any |= key_init_hash(key, hash, mainPW, len);
+
+    if(!any)
+    {
+        hashpw_key_free(key);
+        return NULL;
+    }
+
+    return key;
+}
+
+void hashpw_key_free(struct hashpw_key *key)
+{
+    if(key == NULL) return;
+    key_cleanup(key);
+    secmem_free(key);
+}
 
 void init_PasswordOptions(struct PasswordOptions *opt)
 {
     memset((void*)opt, 0, sizeof(struct PasswordOptions));
 }
 
+void init_PasswordInput(struct PasswordInput *in)
+{
+    memset((void*)in, 0, sizeof(struct PasswordInput));
+}
+
+void hashpw_input_from_options(struct PasswordInput *in, const struct PasswordOptions *opt)
+{
+    in->salt = opt->salt;
+    in->saltlen = strlen(opt->salt);
+    in->descr = opt->descr;
+    in->descrlen = strlen(opt->descr);
+    in->num = opt->num;
+    in->min = opt->min;
+    in->max = opt->max;
+    in->flags = opt->flags;
+    in->hash = opt->hash;
+    in->scheme = opt->scheme;
+}
+
 /*******************************************************************/
 /** Password generation                                           **/
 
@@ -81,150 +509,746 @@ int getpw(const char *mainPW, const char *descr, int num, int min, int max, unsi
     opt.flags = flags;
 
     opt.hash = HASH_RIPEMD160;
+    opt.scheme = SCHEME_REJECT;
 
     return getpw2(&opt, result);
 }
 
 int getpw2(const struct PasswordOptions *opt, char *result)
+{
+    struct hashpw_key key;
+    size_t len = strlen(opt->mainPW);
+    int ret;
+
+    if(len > MAX_INPUT_LENGTH) return -1;
+
+    /* Only derive the states for the algorithm we actually need.
+     * An invalid hash value, or one the backend does not have (the
+     * key does not support it then), is reported as -4 by
+     * getpw2_with_key after the other checks of the input */
+    memset(&key, 0, sizeof(key));
+    if(opt->hash >= 0 && opt->hash <= MAX_HASH_VALUE)
+        key_init_hash(&key, opt->hash, opt->mainPW, len);
+
+    ret = getpw2_with_key(&key, opt, result);
+
+    key_cleanup(&key);
+    secmem_wipe(&key, sizeof(key));
+
+    return ret;
+}
+
+int hashpw_gen_init(struct hashpw_gen *g, const struct PasswordInput *in, char *result)
 {
 	/* format of hashed string:
-	 * <mainPW><seq><descr><num>
+	 * <seq><salt><descr><num>
+	 * keyed with <mainPW>
 	 * where <seq> is sequential number (if more than one hash value is needed)
 	 * where <fl> is 'a'+flags
 	 */
 
-        assert(opt->flags);
-        assert(opt->hash <= MAX_HASH_VALUE);
+        // zero terminate string
+        *result = 0;
 
 	// check for sane input values
-        if(strlen(opt->mainPW) > MAX_INPUT_LENGTH ||
-           strlen(opt->descr) > MAX_INPUT_LENGTH ||
-	   strlen(opt->salt) > MAX_INPUT_LENGTH)
+        if(in->descrlen > MAX_INPUT_LENGTH ||
+	   in->saltlen > MAX_INPUT_LENGTH)
 		return -1;
 
-        if(opt->flags > PARAM_MAX_V2) return -2;
+        // at least one character class
+        if((in->flags & FLAGS_PRINT) == 0 || in->flags > PARAM_MAX_V2) return -2;
+
+        if(in->hash < 0 || in->hash > MAX_HASH_VALUE) return -4;
 
-        if(opt->hash > MAX_HASH_VALUE) return -4;
+        if(in->scheme < 0 || in->scheme > MAX_SCHEME_VALUE) return -6;
 
-        /* If FL_EVENDIST we wait until a character is not a "leading 0" */
-        int password_has_started;
+        if(in->scheme != SCHEME_REJECT)
+        {
+            int b;
 
-        /* number of characters to create or -1 if we don't know that
-         * number (i.e., !FL_EVENDIST and min != max) */
-        int state;
+            if(in->min < 0 || in->max < in->min) return -3;
+            if(!(in->flags & FL_EVENDIST) && in->max-in->min>255) return -3;
 
-        /* Needed to determine length value (if !FL_EVENDIST) */
-        unsigned char mask;
+            g->nalpha = 0;
+            for(b = 0; b < 128; ++b)
+                if(charclass[b] & in->flags) g->alphabet[g->nalpha++] = (char)b;
 
-        if(opt->flags & FL_EVENDIST)
+            g->pool_v = 0;
+            g->pool_n = 1;
+
+            // the length is the first thing taken from the pool
+            g->state = in->max-in->min?-1:in->min;
+            g->lenpos = in->max-in->min;
+            g->lenphase = 0;
+            g->ones = 0;
+        }
+         else if(in->flags & FL_EVENDIST)
         {
-            password_has_started = 0;
-            state = opt->max;
+            if(in->max < 0) return -3;
+
+            g->password_has_started = 0;
+            g->state = in->max;
         }
          else
         {
             /* Determine password size the "classical" way,
              * by selecting it evenly from min .. max */
 
-            if(opt->max-opt->min>255) return -3;
+            if(in->min < 0 || in->max < in->min || in->max-in->min>255) return -3;
 
             /* Do not wait for start of password once we have determined the length */
-            password_has_started = 1;
+            g->password_has_started = 1;
 
             // Determine bit mask for length byte
-            mask = 0;
-            while(opt->max-opt->min && ((opt->max-opt->min) & (128 >> mask)) == 0) mask++;
-            mask = 0xff >> mask;
+            g->mask = 0;
+            while(in->max-in->min && ((in->max-in->min) & (128 >> g->mask)) == 0) g->mask++;
+            g->mask = 0xff >> g->mask;
 
             // both state number and counter
             // too complicated to explain ;-)
-            state = opt->max-opt->min?-1:opt->min;
+            g->state = in->max-in->min?-1:in->min;
         }
 
-	// size of hashed string buffer
-        int tempLength = MAX_INT_REP_LEN*2+strlen(opt->salt)+strlen(opt->descr);
+        g->in = *in;
+        g->result = result;
+        g->seq = 0;
+        g->bytes = 0;
 
-	char *tempStr = (char *)malloc(tempLength+1);
-	if(tempStr == NULL) return -9;
+        return 0;
+}
 
-	unsigned char hmac[EVP_MAX_MD_SIZE];		// hmac output
-        unsigned int hmaclen;                           // length of current hmac
+/* Write the decimal representation of v to p, returns the end */
+static char *format_int(char *p, int v)
+{
+        char digits[MAX_INT_REP_LEN];
+        char *d = digits + sizeof(digits);
+        /* negate as unsigned, which also works for INT_MIN */
+        unsigned u = v < 0 ? 0u-(unsigned)v : (unsigned)v;
+
+        do
+        {
+                *--d = (char)('0' + u%10);
+                u /= 10;
+        } while(u);
+
+        if(v < 0) *p++ = '-';
+
+        memcpy(p, d, digits + sizeof(digits) - d);
+        return p + (digits + sizeof(digits) - d);
+}
+
+size_t hashpw_gen_message(struct hashpw_gen *g, char *buf)
+{
+        char *p = format_int(buf, g->seq++);
+
+        memcpy(p, g->in.salt, g->in.saltlen);
+        p += g->in.saltlen;
+        memcpy(p, g->in.descr, g->in.descrlen);
+        p += g->in.descrlen;
+        p = format_int(p, g->in.num);
+
+        return p - buf;
+}
+
+/* The pool is refilled up to this size before a digit is taken */
+#define POOL_LOW        (1u << 24)
+
+/* Take a digit that is uniform in [0, radix) from the pool of g, which
+ * is refilled from hmac[*i..len). radix must not be larger than 256.
+ * Returns -1 if the output is used up before the pool is full enough.
+ *
+ * pool_v is uniform in [0, pool_n), so if it is below the largest multiple
+ * of radix that is at most pool_n, pool_v % radix is a uniform digit and
+ * pool_v / radix is left as a uniform number for the next digits. Else the
+ * excess is uniform in [0, pool_n % radix) and kept as well, so even the
+ * rare rejections (less than radix/2^24 of the digits) cost almost nothing.
+ * Refilling before every digit (instead of at the end of a block) makes
+ * the password independent of the block size. */
+static int pool_digit(struct hashpw_gen *g, const unsigned char *hmac, unsigned int len,
+                      unsigned int *i, unsigned radix)
+{
+        for(;;)
+        {
+                unsigned limit;
+
+                while(g->pool_n < POOL_LOW)
+                {
+                        if(*i == len) return -1;
+                        g->pool_v = (g->pool_v << 8) | hmac[(*i)++];
+                        g->pool_n <<= 8;
+                }
+
+                limit = g->pool_n - g->pool_n % radix;
+                if(g->pool_v < limit)
+                {
+                        unsigned d = g->pool_v % radix;
+                        g->pool_v /= radix;
+                        g->pool_n = limit / radix;
+                        return (int)d;
+                }
+
+                g->pool_v -= limit;
+                g->pool_n -= limit;
+        }
+}
+
+/* Select the length of a SCHEME_UNBIASED FL_EVENDIST password, returns 0
+ * if the output is used up before.
+ *
+ * With m = max-min and the repunits R_j = 1 + k + ... + k^(j-1) (k is the
+ * number of allowed characters), there are k^min * R_(m+1) passwords, and
+ * min+j is the right length iff R_j <= U < R_(j+1) for a U uniform in
+ * [0, R_(m+1)). These numbers are far too large, but U only has to be
+ * compared with a repunit, which its base k digits decide one by one:
+ *   lenphase 0:  U is uniform in [0, R_(j+1)), j = lenpos. Draw a bit
+ *                 that tells if the proposal V = U + bit*k^j (uniform in
+ *                 [0, 2*k^j)) is below or above k^j.
+ *   lenphase 1:  U is uniform in [0, k^j): min+j if U >= R_j. Else a
+ *                 leading digit 1 gives min+j-1, and a leading 0 leaves
+ *                 U uniform in [0, k^(j-1)), so we go on with j-1.
+ *   lenphase 2:  above k^j: the proposal is accepted iff U < R_j, which
+ *                 gives min+j as U >= k^j > R_j, else we start over.
+ * ones counts the leading digits 1 of U that were compared with R_j. */
+static int select_length(struct hashpw_gen *g, const unsigned char *hmac, unsigned int len,
+                         unsigned int *i)
+{
+        const struct PasswordInput *in = &g->in;
+
+        for(;;)
+        {
+                int d;
+
+                if(g->lenphase == 0)
+                {
+                        d = pool_digit(g, hmac, len, i, 2);
+                        if(d < 0) return 0;
+                        g->lenphase = 1+d;
+                        g->ones = 0;
+                        continue;
+                }
+
+                d = pool_digit(g, hmac, len, i, g->nalpha);
+                if(d < 0) return 0;
 
-	int seq = 0;		// seq
+                if(d == 1 && ++g->ones < g->lenpos) continue;
 
-	unsigned int i = 0;	// index within hmac output
-						// if this is 0, a new
-						// hash (with seq++) will be
-						// created
+                if(d == 0)
+                {
+                        // U < R_j
+                        if(g->lenphase == 2)
+                        {
+                                g->state = in->min + g->lenpos;
+                                return 1;
+                        }
+                        // the leading 1 makes U >= k^(j-1) > R_(j-1)
+                        if(g->ones)
+                        {
+                                g->state = in->min + g->lenpos-1;
+                                return 1;
+                        }
+                        // U < k^(j-1), go on with the next digit and R_(j-1)
+                        if(--g->lenpos == 0)
+                        {
+                                g->state = in->min;
+                                return 1;
+                        }
+                        continue;
+                }
 
-        const EVP_MD *hash_algo = get_evp_md_for_hash(opt->hash);
+                // U >= R_j
+                if(g->lenphase == 1)
+                {
+                        g->state = in->min + g->lenpos;
+                        return 1;
+                }
+                g->lenphase = 0;
+        }
+}
 
-        if(hash_algo == NULL) return -4;
+static void feed_unbiased(struct hashpw_gen *g, const unsigned char *hmac, unsigned int len)
+{
+        const struct PasswordInput *in = &g->in;
+        unsigned int i = 0;
 
-        while(state)
+        if(g->state == -1)
+        {
+                if(in->flags & FL_EVENDIST)
+                {
+                        if(!select_length(g, hmac, len, &i)) goto out;
+                }
+                 else
+                {
+                        int d = pool_digit(g, hmac, len, &i, in->max-in->min+1);
+                        if(d < 0) goto out;
+                        g->state = in->min + d;
+                }
+        }
+
+        {
+                char *result = g->result;
+                int state = g->state;
+
+                while(state)
+                {
+                        int d = pool_digit(g, hmac, len, &i, g->nalpha);
+                        if(d < 0) break;
+                        *result++ = g->alphabet[d];
+                        state--;
+                }
+
+                g->result = result;
+                g->state = state;
+        }
+
+out:
+        g->bytes += i;
+        *g->result = 0;
+}
+
+/* The only HMAC block is the key of the keystream, which
+ * completes the password */
+static void feed_stream(struct hashpw_gen *g, const unsigned char *hmac, unsigned int len)
+{
+        static const unsigned char nonce[CHACHA20_NONCE_SIZE] = { 0 };
+        unsigned char key[CHACHA20_KEY_SIZE];
+        unsigned char block[CHACHA20_BLOCK_SIZE];
+        struct chacha20_ctx c;
+
+        // shorter digests are padded with zeros
+        memset(key, 0, sizeof(key));
+        memcpy(key, hmac, len < sizeof(key) ? len : sizeof(key));
+        chacha20_init(&c, key, nonce, 0);
+
+        while(!hashpw_gen_done(g))
+        {
+                chacha20_block(&c, block);
+                feed_unbiased(g, block, sizeof(block));
+        }
+
+        secmem_wipe(key, sizeof(key));
+        secmem_wipe(block, sizeof(block));
+        secmem_wipe(&c, sizeof(c));
+}
+
+void hashpw_gen_feed(struct hashpw_gen *g, const unsigned char *hmac, unsigned int len)
+{
+        const struct PasswordInput *in = &g->in;
+
+        if(in->scheme == SCHEME_UNBIASED)
+        {
+                feed_unbiased(g, hmac, len);
+                return;
+        }
+        if(in->scheme == SCHEME_STREAM)
+        {
+                feed_stream(g, hmac, len);
+                return;
+        }
+
+	unsigned int i = len;	// index within hmac output
+
+        /* The phases below are gone through in order, each one in its own
+         * loop, so the loop that creates the characters does not have to
+         * check for the others */
+
+        // if state == -1, we are determining the length of the password
+        while(g->state == -1 && i)
+        {
+                unsigned char b = hmac[--i] & g->mask;
+                if(b < in->max-in->min) g->state = ((int)b)+in->min;
+        }
+
+        /* As long as we have more than min character
+         * to create, we can have leading zeros,
+         * If only min chars are left, we must
+         * start. The first non-zero byte is not consumed
+         * here, but tested as a password byte below */
+        while(g->state && !g->password_has_started && i)
+        {
+                if(hmac[i-1] != 0 || g->state == in->min)
+                        g->password_has_started = 1;
+                else
+                        --i;
+        }
+
+        // else we are retrieving the next passwort byte
+        {
+                char *result = g->result;
+                int state = g->state;
+                unsigned char flags = (unsigned char)in->flags;
+
+                while(state && i)
+                {
+                        unsigned char b = hmac[--i];
+
+                        // test if b is a valid byte
+                        if(charclass[b] & flags)
+                        {
+                                // okay, valid char
+                                *result++ = (char)b;
+                                state--;
+                        }
+                }
+
+                g->result = result;
+                g->state = state;
+        }
+
+        g->bytes += len - i;
+        *g->result = 0;
+}
+
+void hashpw_gen_cost(const struct hashpw_gen *g, const char *result, struct PasswordCost *cost)
+{
+        cost->blocks = g->seq;
+        cost->bytes = g->bytes;
+        if(g->in.scheme != SCHEME_REJECT)
+                cost->rejected = g->bytes - (g->result - result)*log(g->nalpha)/log(256.0);
+        else
+                cost->rejected = g->bytes - (unsigned)(g->result - result);
+}
+
+/* At most this many blocks of a single password are computed ahead,
+ * their messages share a buffer of this size */
+#define SPECULATE_MAX           64
+#define SPECULATE_BUFFER        16384
+
+/* Number of blocks to compute in the first call to the backend for the
+ * password of g */
+static int first_ahead(const struct hashpw_key *key, const struct hashpw_gen *g)
+{
+        /* The blocks only depend on seq, so the number of them the
+         * password is expected to need is computed up front in one
+         * call. The multi-buffer kernels fill all lanes in about the
+         * time of lanes/4 single blocks, so this only pays off for
+         * passwords that are expected to need more. If that runs short,
+         * one more block per lane follows each time (see run). Without
+         * lanes to fill this is the plain serial loop. */
+        int lanes = hashpw_key_lanes(key, g->in.hash);
+        struct PasswordCost est;
+
+        if(lanes > 1 && hashpw_estimate(&g->in, &est) == 0 && est.blocks*4 > lanes)
+                return ((int)ceil(est.blocks)+lanes-1) / lanes * lanes;
+
+        return 1;
+}
+
+/* Compute and feed the blocks of g until the password is done, but at
+ * most maxblocks of them (no limit if maxblocks <= 0) and only as long
+ * as cancel is NULL or *cancel is 0. *ahead is the number of blocks for
+ * the next call to the backend (see first_ahead), it is updated so the
+ * next call to run can go on where this one stopped.
+ * Returns 0 if the password is done, -7 resp. -8 if the budget is used
+ * up resp. cancel was set before, -9 on failure */
+static int run(const struct hashpw_key *key, struct hashpw_gen *g, int *ahead,
+               int maxblocks, const volatile int *cancel)
+{
+        char msgbuf[SPECULATE_BUFFER];                  // hashed strings
+        const unsigned char *msg[SPECULATE_MAX];
+        size_t len[SPECULATE_MAX];
+        unsigned char hmac[SPECULATE_MAX][HASHPW_MAX_MD_SIZE];  // hmac outputs
+        unsigned int hmaclen;                           // length of current hmac
+        int ret = 0;
+
+        // number of messages that surely fit into msgbuf
+        int room = SPECULATE_BUFFER / (MAX_INT_REP_LEN*2+g->in.saltlen+g->in.descrlen);
+        if(room > SPECULATE_MAX) room = SPECULATE_MAX;
+
+        // with overwhelming probability, this
+        // loop will terminate (or the budget will)
+        while(!hashpw_gen_done(g))
 	{
-		// retrieve a single byte
-		if(i == 0)
-		{
-			// next hmac
-                        snprintf(tempStr, tempLength, "%i%s%s%i",
-				seq++,
-                                opt->salt,
-                                opt->descr,
-                                opt->num);
-
-                        HMAC(hash_algo,
-                                opt->mainPW, strlen(opt->mainPW),
-				(unsigned char *)tempStr, strlen(tempStr),
-				hmac, &hmaclen);
-			
-			i = hmaclen;
-		}
-
-		unsigned char b = hmac[--i];
-
-		// if state == -1, we are determining the length of the password
-		if(state == -1)
-		{
-			b &= mask;
-                        if(b < opt->max-opt->min) state = ((int)b)+opt->min;
-			continue;
-		}
-
-                if(!password_has_started)
-                {
-                    /* As long as we have more than min character
-                     * to create, we can have leading zeros,
-                     * If only min chars are left, we must
-                     * start */
-                    if( b != 0 || state == opt->min)
-                    {
-                        password_has_started = 1;
-                    }
-                     else
-                    continue;
-                }
-
-		// else we are retrieving the next passwort byte
-		// test if b is a valid byte
-                if( ((opt->flags&FL_LOWER) && islower(b)) ||
-                        ((opt->flags&FL_UPPER) && isupper(b)) ||
-                        ((opt->flags&FL_DIGIT) && isdigit(b)) ||
-                        ((opt->flags&FL_SPECIAL) && b!= 0 && strchr(specialchars, b)))
-		{
-			// okay, valid char
-			*result++ = (char)b;
-			state--;
-		}
-
-		// with overwhelming probability, this
-		// loop will terminate
+                int n = *ahead < room ? *ahead : room, i;
+                char *p = msgbuf;
+
+                if(cancel && *cancel)
+                {
+                        ret = -8;
+                        break;
+                }
+                if(maxblocks > 0 && n > maxblocks) n = maxblocks;
+
+                for(i = 0; i < n; ++i)
+                {
+                        msg[i] = (const unsigned char *)p;
+                        len[i] = hashpw_gen_message(g, p);
+                        p += len[i];
+                }
+
+                if(!hashpw_key_hmac_many(key, g->in.hash, n, msg, len,
+                                         hmac[0], sizeof(hmac[0]), &hmaclen))
+                {
+                        ret = -9;
+                        break;
+                }
+
+                for(i = 0; i < n && !hashpw_gen_done(g); ++i)
+                        hashpw_gen_feed(g, hmac[i], hmaclen);
+
+                // blocks computed ahead but not needed do not count
+                g->seq -= n-i;
+                if(*ahead > 1) *ahead = hashpw_key_lanes(key, g->in.hash);
+
+                if(maxblocks > 0 && (maxblocks -= n) == 0 && !hashpw_gen_done(g))
+                {
+                        ret = -7;
+                        break;
+                }
 	}
 
-	free(tempStr);
+        secmem_wipe(hmac, sizeof(hmac));
+        return ret;
+}
+
+/* getpw3_cost without the check of the result size, cost may be NULL */
+static int generate(const struct hashpw_key *key, const struct PasswordInput *in, char *result,
+                    struct PasswordCost *cost)
+{
+        struct hashpw_gen g;
+        int ahead, ret = hashpw_gen_init(&g, in, result);
+
+        if(ret != 0) return ret;
+
+        // not supported by the backend of key
+        if(!hashpw_key_supports(key, in->hash)) return -4;
 
-	// zero terminate string
-	*result=0;
+        ahead = first_ahead(key, &g);
+        ret = run(key, &g, &ahead, 0, NULL);
+        if(ret != 0)
+        {
+                *result = 0;
+                return ret;
+        }
+
+        if(cost) hashpw_gen_cost(&g, result, cost);
 
 	return 0;
 }
+
+int getpw2_with_key(const struct hashpw_key *key, const struct PasswordOptions *opt, char *result)
+{
+        struct PasswordInput in;
+
+        hashpw_input_from_options(&in, opt);
+
+        return generate(key, &in, result, NULL);
+}
+
+int getpw3(const struct hashpw_key *key, const struct PasswordInput *in, char *result, size_t resultsize)
+{
+        return getpw3_cost(key, in, result, resultsize, NULL);
+}
+
+int getpw3_cost(const struct hashpw_key *key, const struct PasswordInput *in,
+                char *result, size_t resultsize, struct PasswordCost *cost)
+{
+        if(resultsize == 0) return -5;
+
+        *result = 0;
+
+        if(in->max > 0 && (size_t)in->max >= resultsize) return -5;
+
+        return generate(key, in, result, cost);
+}
+
+/*******************************************************************/
+/** Bounded generation                                            **/
+
+struct hashpw_job
+{
+    const struct hashpw_key *key;
+    struct hashpw_gen g;
+    int ahead;                  /* see run */
+    int status;                 /* of the last hashpw_job_run */
+    char *result;               /* start of the password */
+};
+
+struct hashpw_job *hashpw_job_new(const struct hashpw_key *key, const struct PasswordInput *in,
+                                  int *error)
+{
+        struct hashpw_job *job;
+        struct hashpw_gen check;
+        struct PasswordInput copy;
+        char dummy, *p;
+        size_t size;
+        int ret = hashpw_gen_init(&check, in, &dummy);
+
+        if(ret == 0 && !hashpw_key_supports(key, in->hash)) ret = -4;
+
+        if(ret != 0)
+        {
+                if(error) *error = ret;
+                return NULL;
+        }
+
+        /* the job, copies of salt and descr and the result in one block */
+        size = sizeof(struct hashpw_job) + in->saltlen + in->descrlen + (in->max > 0 ? in->max : 0) + 1;
+        job = (struct hashpw_job *)secmem_alloc(size);
+        if(job == NULL)
+        {
+                if(error) *error = -9;
+                return NULL;
+        }
+
+        p = (char *)(job+1);
+        copy = *in;
+        copy.salt = memcpy(p, in->salt, in->saltlen);
+        p += in->saltlen;
+        copy.descr = memcpy(p, in->descr, in->descrlen);
+        p += in->descrlen;
+
+        job->key = key;
+        job->status = -7;
+        job->result = p;
+        hashpw_gen_init(&job->g, &copy, job->result);
+        job->ahead = first_ahead(key, &job->g);
+
+        if(error) *error = 0;
+        return job;
+}
+
+int hashpw_job_run(struct hashpw_job *job, int maxblocks, const volatile int *cancel)
+{
+        // done or failed for good
+        if(job->status == 0 || job->status == -9) return job->status;
+
+        job->status = run(job->key, &job->g, &job->ahead, maxblocks, cancel);
+        return job->status;
+}
+
+const char *hashpw_job_result(const struct hashpw_job *job)
+{
+        return job->status == 0 ? job->result : NULL;
+}
+
+int hashpw_job_blocks(const struct hashpw_job *job)
+{
+        return job->g.seq;
+}
+
+int hashpw_job_cost(const struct hashpw_job *job, struct PasswordCost *cost)
+{
+        if(job->status != 0) return job->status;
+
+        hashpw_gen_cost(&job->g, job->result, cost);
+        return 0;
+}
+
+void hashpw_job_free(struct hashpw_job *job)
+{
+        // wipes the password and the unused part of the output
+        secmem_free(job);
+}
+
+/*******************************************************************/
+/** Cost estimation                                               **/
+
+int hashpw_estimate(const struct PasswordInput *in, struct PasswordCost *cost)
+{
+        struct hashpw_gen g;
+        char dummy;
+        double p, chars, bytes;
+        int allowed = 0;
+        int b, ret, size;
+
+        memset(cost, 0, sizeof(struct PasswordCost));
+
+        // same checks as for creating the password
+        ret = hashpw_gen_init(&g, in, &dummy);
+        if(ret != 0) return ret;
+
+        if(hashpw_gen_done(&g)) return 0;
+
+        if(in->scheme != SCHEME_REJECT)
+        {
+                double k = g.nalpha;
+                double perchar = log(k)/log(256.0);     // bytes per character
+                double length = 0;                      // bytes for the length
+                double w = 1, sum = 0, blocks = 0;
+                int m = in->max - in->min;
+                int j;
+
+                size = digest_size(in->hash);
+
+                if(m && (in->flags & FL_EVENDIST))
+                {
+                        /* A try takes a bit and about k/(k-1) digits and is
+                         * accepted with probability 1/2 + 1/(2(k-1)) */
+                        length = (1/8.0 + perchar*k/(k-1)) / (0.5 + 0.5/(k-1));
+                }
+                 else if(m)
+                        length = log(m+1.0)/log(256.0);
+
+                /* The output is used up at an almost constant rate, so
+                 * the number of blocks for max-j characters is known
+                 * well. Before every digit the pool holds 3 to 4 bytes,
+                 * so about 3.5 bytes less the last digit are left over at
+                 * the end. With FL_EVENDIST, max-j has a probability
+                 * proportional to k^-j, else all lengths are equally
+                 * likely */
+                chars = bytes = 0;
+                for(j = 0; j <= m && w > 1e-20; ++j)
+                {
+                        double b = (in->max-j)*perchar + length + 3.5 - perchar;
+
+                        if(b < 3) b = 3;
+                        sum += w;
+                        chars += w*(in->max-j);
+                        bytes += w*b;
+                        blocks += w*ceil(b/size);
+                        if(in->flags & FL_EVENDIST) w /= k;
+                }
+
+                chars /= sum;
+                cost->blocks = in->scheme == SCHEME_STREAM ? 1 : blocks/sum;
+                cost->bytes = bytes/sum;
+                cost->rejected = cost->bytes - chars*perchar;
+
+                return 0;
+        }
+
+        // probability that a byte becomes a character
+        for(b = 0; b < 256; ++b)
+                if(charclass[b] & in->flags) allowed++;
+        p = allowed/256.0;
+
+        if(in->flags & FL_EVENDIST)
+        {
+                chars = in->max;
+
+                /* A leading zero is skipped with probability 1/256, so
+                 * 1/255 are expected. The first byte after them is not 0,
+                 * so it is accepted with probability allowed/255 */
+                if(in->max != in->min)
+                        bytes = 1.0/255 + 1 + (1 - allowed/255.0)/p + (chars-1)/p;
+                else
+                        bytes = chars/p;
+        }
+         else
+        {
+                int range = in->max - in->min;
+
+                if(range)
+                {
+                        // a length byte is accepted with probability range/(mask+1)
+                        chars = in->min + (range-1)/2.0;
+                        bytes = (g.mask+1.0)/range + chars/p;
+                }
+                 else
+                {
+                        chars = in->min;
+                        bytes = chars/p;
+                }
+        }
+
+        /* Every block is used up completely, except for the last one, of
+         * which on average a half is left (assuming that the total is
+         * spread over more than one block). At least one block is needed */
+        size = digest_size(in->hash);
+        cost->blocks = bytes/size + (size-1)/(2.0*size);
+        if(cost->blocks < 1) cost->blocks = 1;
+        cost->bytes = bytes;
+        cost->rejected = bytes - chars;
+
+        return 0;
+}
@@ -20,7 +20,9 @@
 #ifndef HASHPW_H
 #define HASHPW_H
 
-#define HASHPW_VERSION  2
+#define HASHPW_VERSION  3
+
+#include <stddef.h>
 
 /****** allowed chars for the password (v1+) ******/
 
@@ -51,6 +53,35 @@
 #define HASH_DSS1       2
 #define HASH_MD5        3
 
+/* (v3+) The HMAC of BLAKE2b is the one of RFC 2104 with BLAKE2b-512 as
+ * the hash function (128 byte blocks), not the keyed mode of BLAKE2 */
+#define HASH_SHA256     4
+#define HASH_SHA512     5
+#define HASH_BLAKE2B    6
+
+/****** generation schemes (v3+) ******/
+
+/* How the HMAC output becomes a password:
+ *   SCHEME_REJECT    (v1/v2) every output byte that is not an allowed
+ *                    character is skipped, so for small alphabets most of
+ *                    the output is thrown away
+ *   SCHEME_UNBIASED  the output is read as a stream of uniform digits in
+ *                    base "number of allowed characters" (with rejection
+ *                    of the rare values that would bias the modulo), so
+ *                    nearly every bit ends up in the password. The length
+ *                    is selected evenly from min .. max (both included),
+ *                    or with FL_EVENDIST exactly in proportion to the
+ *                    number of passwords of each length.
+ *   SCHEME_STREAM    same as SCHEME_UNBIASED, but only a single HMAC is
+ *                    computed, whose output is the key of a ChaCha20
+ *                    keystream that supplies the digits. Long passwords
+ *                    (or key material) cost one HMAC and cheap streaming
+ *                    instead of an HMAC every 16-20 bytes.
+ * The same account gives different passwords with different schemes. */
+#define SCHEME_REJECT   0
+#define SCHEME_UNBIASED 1
+#define SCHEME_STREAM   2
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -66,6 +97,7 @@ struct PasswordOptions
     int max;                  /* maximum length of password */
     unsigned flags;           /* flags (see above FL_ constants) */
     int hash;                 /* hash algorithm to use (see above HASH_ constants) */
+    int scheme;               /* (v3+) see above SCHEME_ constants */
 };
 
 /* For upwards compatibility, call this function before filling in the values
@@ -80,14 +112,170 @@ void init_PasswordOptions(struct PasswordOptions *opt);
  * returns:
  * 	-1 - input strings longer than allowed
  * 	-2 - invalid flags
- * 	-3 - we cannot handle (max-min)>255 when FL_EVENDIST is not set
+ * 	-3 - we cannot handle (max-min)>255 when FL_EVENDIST is not set,
+ * 	     or negative/inverted lengths (with SCHEME_UNBIASED and
+ * 	     SCHEME_STREAM, min must not be larger than max even with
+ * 	     FL_EVENDIST)
  *      -4 - (v2+) unknown/unsupported hash algorithm
+ *      -5 - (v3, batch) result buffer too small for max
+ *      -6 - (v3+) unknown generation scheme
+ *      -7 - (v3, hashpw_job_run) the work budget is used up
+ *      -8 - (v3, hashpw_job_run) cancelled
  * 	-9 - not enough memory (i mean, honestly, can this happen these days?)
  */
 int getpw(const char *mainPW, const char *descr, int num, int min, int max, unsigned flags, char *result);
 
 int getpw2(const struct PasswordOptions *opt, char *result);
 
+/****** precomputed main password (v2+) ******/
+
+/* A hashpw_key holds the HMAC inner and outer hash states that result
+ * from absorbing the main password, for every supported hash algorithm.
+ * Create it once (e.g. when an account set is unlocked) and use it for
+ * every password instead of hashing the main password again each time.
+ * A key is never modified after creation, so it may be shared by several
+ * threads. */
+struct hashpw_key;
+
+/* returns NULL if mainPW is longer than allowed or there is not enough memory */
+struct hashpw_key *hashpw_key_new(const char *mainPW);
+
+void hashpw_key_free(struct hashpw_key *key);
+
+/* Same as getpw2, but the main password is taken from key
+ * (opt->mainPW is ignored) */
+int getpw2_with_key(const struct hashpw_key *key, const struct PasswordOptions *opt, char *result);
+
+/****** explicit lengths (v3+) ******/
+
+/* Same as PasswordOptions without mainPW, but the strings are given
+ * with their length in bytes and need not be zero terminated */
+struct PasswordInput
+{
+    const char *salt;         /* main salt value */
+    size_t saltlen;
+    const char *descr;        /* description string (i.e. login) */
+    size_t descrlen;
+    int num;                  /* sequential number of password (normally 0) */
+    int min;                  /* minimum length of password */
+    int max;                  /* maximum length of password */
+    unsigned flags;           /* flags (see above FL_ constants) */
+    int hash;                 /* hash algorithm to use (see above HASH_ constants) */
+    int scheme;               /* see above SCHEME_ constants */
+};
+
+/* see init_PasswordOptions */
+void init_PasswordInput(struct PasswordInput *in);
+
+/* Same as getpw2_with_key, but result has room for resultsize bytes,
+ * which must be at least max+1 (else -5 is returned). Never allocates
+ * memory for the algorithms that have an in-tree implementation (all of
+ * the above), so it is cheap enough to call in a loop. */
+int getpw3(const struct hashpw_key *key, const struct PasswordInput *in, char *result, size_t resultsize);
+
+/****** cost estimation ******/
+
+/* Work needed for one password. bytes counts the HMAC output bytes that
+ * were looked at, rejected those of them that did not become a character
+ * of the password (length bytes, leading zeros and bytes outside of the
+ * allowed characters). With SCHEME_UNBIASED a byte may carry parts of
+ * several characters, so rejected is bytes minus the information content
+ * of the password, i.e. its length times log256(number of allowed chars).
+ * With SCHEME_STREAM, blocks is always 1 and bytes counts the keystream. */
+struct PasswordCost
+{
+    double blocks;            /* HMAC invocations */
+    double bytes;
+    double rejected;
+};
+
+/* Expected cost of the password for in, without creating it (salt and
+ * descr do not matter). The number of blocks is an approximation, bytes
+ * and rejected are exact expectations for SCHEME_REJECT and close
+ * approximations for the other schemes.
+ * Returns 0 or the error code getpw3 would return */
+int hashpw_estimate(const struct PasswordInput *in, struct PasswordCost *cost);
+
+/* Same as getpw3, and stores the actual cost of the password in cost */
+int getpw3_cost(const struct hashpw_key *key, const struct PasswordInput *in,
+                char *result, size_t resultsize, struct PasswordCost *cost);
+
+/****** bounded generation (v3+) ******/
+
+/* The functions above loop until the password is done, which takes a
+ * random number of HMAC blocks without an upper bound (and a huge max
+ * with FL_EVENDIST takes long anyway). A hashpw_job creates the password
+ * in steps of a bounded number of blocks instead, so a caller can keep
+ * its latency predictable, show progress or give up. */
+struct hashpw_job;
+
+/* Start the password for in with key (the strings of in are copied, key
+ * must outlive the job), nothing is computed yet.
+ * Returns NULL and stores the error code of getpw3 in *error (if error
+ * is not NULL) if in is invalid or there is not enough memory. */
+struct hashpw_job *hashpw_job_new(const struct hashpw_key *key, const struct PasswordInput *in,
+                                  int *error);
+
+/* Go on with the password, computing at most maxblocks HMAC blocks (no
+ * limit if maxblocks <= 0). If cancel is not NULL, *cancel is checked
+ * before every call to the backend (every block or lane group), so
+ * another thread (or a signal handler) can stop the job by setting it.
+ * Returns 0 once the password is done, -7 if the budget is used up and
+ * -8 if cancelled; in both cases the job can be resumed by calling this
+ * again. -9 means the backend failed. */
+int hashpw_job_run(struct hashpw_job *job, int maxblocks, const volatile int *cancel);
+
+/* The password, or NULL if it is not done yet */
+const char *hashpw_job_result(const struct hashpw_job *job);
+
+/* Number of HMAC blocks that went into the password so far */
+int hashpw_job_blocks(const struct hashpw_job *job);
+
+/* Store the cost of the password like getpw3_cost. Returns 0 or the
+ * result of the last hashpw_job_run if the password is not done */
+int hashpw_job_cost(const struct hashpw_job *job, struct PasswordCost *cost);
+
+/* Wipe and free the job including the password, job may be NULL */
+void hashpw_job_free(struct hashpw_job *job);
+
+/****** hash backends ******/
+
+/* The HMACs are computed by a backend:
+ *   "builtin"  in-tree hash functions with SIMD multi-buffer kernels
+ *              (always available, the default)
+ *   "openssl"  OpenSSL (not available if built with HASHPW_NO_OPENSSL)
+ * Both give the same passwords. */
+
+/* Select the backend of the keys created from now on, existing keys
+ * keep theirs. NULL selects the default.
+ * Returns 0 if there is no such backend */
+int hashpw_backend_select(const char *name);
+
+/* name of the current backend */
+const char *hashpw_backend(void);
+
+/* name of the i-th available backend or NULL if i is out of range */
+const char *hashpw_backend_name(int i);
+
+/****** batch generation ******/
+
+/* Create the passwords for all n entries of opts using nthreads threads
+ * (nthreads <= 0 means one thread per online CPU). The workers take
+ * small chunks from their own part of opts and steal from the others
+ * when they run out, so uneven costs per account are balanced.
+ *
+ * The password for opts[i] is written to results + i*stride, so results
+ * must hold n*stride bytes; stride must be larger than every max.
+ * The return code of each password (see above) is stored in status[i],
+ * and if costs is not NULL, its actual cost in costs[i].
+ * The initial shares of the workers have about the same expected cost
+ * (see hashpw_estimate).
+ *
+ * Returns the number of passwords that could not be created. */
+int getpw2_batch(const struct hashpw_key *key, const struct PasswordOptions *opts, int n,
+                 char *results, size_t stride, int *status, struct PasswordCost *costs,
+                 int nthreads);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,438 @@
+/*
+ * Copyright 2010 (c) Sascha Mueller <mailbox@saschamueller.com>
+ *
+ * This file is part of qhashpw.
+ *
+ * qhashpw is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * qhashpw is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with qhashpw.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef HASHPW_NO_THREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#include "hashpw.h"
+#include "hashpw_internal.h"
+#include "secmem.h"
+
+/* Number of passwords a worker takes from its queue at once */
+#define BATCH_CHUNK     8
+
+/* Number of passwords a worker generates in lockstep. This should be at
+ * least the number of lanes of the widest multi-buffer kernel */
+#define BATCH_SLOTS     32
+
+/* Upper limit for the number of worker threads */
+#define BATCH_MAX_THREADS       256
+
+struct batch_job
+{
+    const struct hashpw_key *key;
+    const struct PasswordOptions *opts;
+    char *results;
+    size_t stride;
+    int *status;
+    struct PasswordCost *costs;     /* may be NULL */
+};
+
+/* Supplies the index of the next password to create
+ * or -1 if there are none left */
+typedef int (*batch_next_fn)(void *ctx);
+
+/* Create all passwords supplied by next, returns the number of failures.
+ *
+ * Up to BATCH_SLOTS passwords advance one HMAC block per round, and the
+ * blocks of all passwords with the same algorithm are computed by one
+ * hashpw_key_hmac_many call, which lets the multi-buffer kernels fill
+ * their lanes. A finished password is replaced by the next one right away. */
+static int batch_run(const struct batch_job *job, batch_next_fn next, void *ctx)
+{
+    struct hashpw_gen gen[BATCH_SLOTS];
+    int index[BATCH_SLOTS];                 /* password of each slot */
+    char msgbuf[BATCH_SLOTS][HASHPW_MESSAGE_SIZE];
+    unsigned char hmac[BATCH_SLOTS][HASHPW_MAX_MD_SIZE];
+    const unsigned char *msg[BATCH_SLOTS];
+    size_t len[BATCH_SLOTS];
+    unsigned int hmaclen;
+    int active[BATCH_SLOTS], nactive = 0;   /* slots in use */
+    int freeslots[BATCH_SLOTS], nfree = BATCH_SLOTS;
+    int same[BATCH_SLOTS], nsame;
+    int exhausted = 0;
+    int failed = 0;
+    int i, j, hash;
+
+    for(i = 0; i < BATCH_SLOTS; ++i) freeslots[i] = i;
+
+    for(;;)
+    {
+        /* fill the free slots */
+        while(nfree && !exhausted)
+        {
+            int slot = freeslots[nfree-1];
+            char *result;
+            struct PasswordInput in;
+
+            i = next(ctx);
+            if(i < 0)
+            {
+                exhausted = 1;
+                break;
+            }
+
+            result = job->results + i*job->stride;
+            hashpw_input_from_options(&in, &job->opts[i]);
+
+            if(in.max > 0 && (size_t)in.max >= job->stride)
+                job->status[i] = -5;
+            else
+                job->status[i] = hashpw_gen_init(&gen[slot], &in, result);
+
+            /* the same order of checks as getpw3 */
+            if(job->status[i] == 0 && !hashpw_key_supports(job->key, in.hash))
+                job->status[i] = -4;
+
+            if(job->costs) memset(&job->costs[i], 0, sizeof(struct PasswordCost));
+
+            if(job->status[i] != 0)
+            {
+                *result = 0;
+                failed++;
+            }
+             else if(!hashpw_gen_done(&gen[slot]))
+            {
+                index[slot] = i;
+                active[nactive++] = slot;
+                nfree--;
+            }
+        }
+
+        if(nactive == 0) break;
+
+        for(hash = 0; hash <= MAX_HASH_VALUE; ++hash)
+        {
+            nsame = 0;
+            for(j = 0; j < nactive; ++j)
+            {
+                struct hashpw_gen *g = &gen[active[j]];
+
+                if(g->in.hash != hash) continue;
+
+                len[nsame] = hashpw_gen_message(g, msgbuf[nsame]);
+                msg[nsame] = (const unsigned char *)msgbuf[nsame];
+                same[nsame++] = active[j];
+            }
+
+            if(nsame == 0) continue;
+
+            if(!hashpw_key_hmac_many(job->key, hash, nsame, msg, len,
+                                     hmac[0], sizeof(hmac[0]), &hmaclen))
+            {
+                for(j = 0; j < nsame; ++j)
+                {
+                    job->status[index[same[j]]] = -9;
+                    *(job->results + index[same[j]]*job->stride) = 0;
+                    gen[same[j]].state = 0;     /* stop it */
+                    failed++;
+                }
+                continue;
+            }
+
+            for(j = 0; j < nsame; ++j)
+                hashpw_gen_feed(&gen[same[j]], hmac[j], hmaclen);
+        }
+
+        /* release the slots of the finished ones */
+        for(i = j = 0; i < nactive; ++i)
+            if(hashpw_gen_done(&gen[active[i]]))
+            {
+                int k = index[active[i]];
+
+                if(job->costs && job->status[k] == 0)
+                    hashpw_gen_cost(&gen[active[i]], job->results + k*job->stride, &job->costs[k]);
+                freeslots[nfree++] = active[i];
+            }
+            else
+                active[j++] = active[i];
+        nactive = j;
+    }
+
+    // the output and what the generators have left of it
+    secmem_wipe(hmac, sizeof(hmac));
+    secmem_wipe(gen, sizeof(gen));
+
+    return failed;
+}
+
+/* batch_next_fn for a single thread */
+struct batch_range
+{
+    int next;
+    int end;
+};
+
+static int batch_next_serial(void *ctx)
+{
+    struct batch_range *r = (struct batch_range *)ctx;
+    return r->next < r->end ? r->next++ : -1;
+}
+
+#ifndef HASHPW_NO_THREADS
+
+/* The part of the indices that is currently owned by one worker.
+ * The owner takes from the front, thieves take from the back. */
+struct batch_queue
+{
+    pthread_mutex_t lock;
+    int next;
+    int end;
+};
+
+struct batch_worker
+{
+    const struct batch_job *job;
+    struct batch_queue *queues;
+    int nqueues;
+    int self;
+    struct batch_range chunk;   /* indices taken from the queue, not yet started */
+    int failed;
+};
+
+/* Take up to BATCH_CHUNK indices from the front of q.
+ * Returns 0 if q is empty */
+static int batch_pop(struct batch_queue *q, struct batch_range *chunk)
+{
+    int ok;
+
+    pthread_mutex_lock(&q->lock);
+    ok = q->next < q->end;
+    if(ok)
+    {
+        chunk->next = q->next;
+        q->next += BATCH_CHUNK;
+        if(q->next > q->end) q->next = q->end;
+        chunk->end = q->next;
+    }
+    pthread_mutex_unlock(&q->lock);
+
+    return ok;
+}
+
+/* Move the back half of the remaining indices of some other
+ * queue into the (empty) queue of w. Returns 0 if all queues are empty */
+static int batch_steal(struct batch_worker *w)
+{
+    int i;
+
+    for(i = 1; i < w->nqueues; ++i)
+    {
+        struct batch_queue *victim = &w->queues[(w->self+i) % w->nqueues];
+        int first = 0, end = 0;
+
+        pthread_mutex_lock(&victim->lock);
+        if(victim->next < victim->end)
+        {
+            end = victim->end;
+            first = victim->end - (victim->end - victim->next + 1)/2;
+            victim->end = first;
+        }
+        pthread_mutex_unlock(&victim->lock);
+
+        if(first < end)
+        {
+            struct batch_queue *own = &w->queues[w->self];
+
+            pthread_mutex_lock(&own->lock);
+            own->next = first;
+            own->end = end;
+            pthread_mutex_unlock(&own->lock);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* batch_next_fn of a worker: from the current chunk,
+ * else from the own queue, else stolen */
+static int batch_next_worker(void *ctx)
+{
+    struct batch_worker *w = (struct batch_worker *)ctx;
+
+    while(w->chunk.next >= w->chunk.end)
+        if(!batch_pop(&w->queues[w->self], &w->chunk) && !batch_steal(w))
+            return -1;
+
+    return w->chunk.next++;
+}
+
+static void *batch_thread(void *arg)
+{
+    struct batch_worker *w = (struct batch_worker *)arg;
+
+    w->failed = batch_run(w->job, batch_next_worker, w);
+
+    return NULL;
+}
+
+/* Expected cost of a password, in HMAC blocks */
+static double batch_cost(const struct PasswordOptions *opt)
+{
+    struct PasswordInput in;
+    struct PasswordCost cost;
+
+    hashpw_input_from_options(&in, opt);
+    if(hashpw_estimate(&in, &cost) != 0) return 0;
+    return cost.blocks;
+}
+
+/* Give every queue a contiguous share of about the same expected cost,
+ * so the workers seldom have to steal */
+static void batch_split(const struct PasswordOptions *opts, int n,
+                        struct batch_queue *queues, int nqueues)
+{
+    double *cost = (double *)malloc(n*sizeof(double));
+    double total = 0, sum = 0;
+    int i, q = 0;
+
+    if(cost == NULL)
+    {
+        // equal number of passwords instead
+        for(q = 0; q < nqueues; ++q)
+        {
+            queues[q].next = (int)((long long)n*q/nqueues);
+            queues[q].end = (int)((long long)n*(q+1)/nqueues);
+        }
+        return;
+    }
+
+    for(i = 0; i < n; ++i)
+    {
+        cost[i] = batch_cost(&opts[i]);
+        total += cost[i];
+    }
+
+    queues[0].next = 0;
+    for(i = 0; i < n; ++i)
+    {
+        sum += cost[i];
+        while(q < nqueues-1 && sum >= total*(q+1)/nqueues)
+        {
+            queues[q].end = i+1;
+            queues[++q].next = i+1;
+        }
+    }
+    while(q < nqueues-1)
+    {
+        queues[q].end = n;
+        queues[++q].next = n;
+    }
+    queues[q].end = n;
+
+    free(cost);
+}
+
+static int batch_default_threads(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n < 1 ? 1 : (int)n;
+}
+
+#endif
+
+int getpw2_batch(const struct hashpw_key *key, const struct PasswordOptions *opts, int n,
+                 char *results, size_t stride, int *status, struct PasswordCost *costs,
+                 int nthreads)
+{
+    struct batch_job job;
+    struct batch_range range;
+
+    job.key = key;
+    job.opts = opts;
+    job.results = results;
+    job.stride = stride;
+    job.status = status;
+    job.costs = costs;
+
+#ifndef HASHPW_NO_THREADS
+    if(nthreads <= 0) nthreads = batch_default_threads();
+    if(nthreads > BATCH_MAX_THREADS) nthreads = BATCH_MAX_THREADS;
+    /* no point in threads that would not even fill their slots */
+    if(nthreads > (n+BATCH_SLOTS-1)/BATCH_SLOTS) nthreads = (n+BATCH_SLOTS-1)/BATCH_SLOTS;
+
+    if(nthreads > 1)
+    {
+        struct batch_queue *queues = (struct batch_queue *)malloc(nthreads*sizeof(struct batch_queue));
+        struct batch_worker *workers = (struct batch_worker *)malloc(nthreads*sizeof(struct batch_worker));
+        pthread_t *threads = (pthread_t *)malloc(nthreads*sizeof(pthread_t));
+        int started, failed = 0;
+        int i;
+
+        if(queues == NULL || workers == NULL || threads == NULL)
+        {
+            free(queues);
+            free(workers);
+            free(threads);
+            goto serial;
+        }
+
+        /* Initially every worker owns a share of the same expected cost */
+        batch_split(opts, n, queues, nthreads);
+        for(i = 0; i < nthreads; ++i)
+        {
+            pthread_mutex_init(&queues[i].lock, NULL);
+
+            workers[i].job = &job;
+            workers[i].queues = queues;
+            workers[i].nqueues = nthreads;
+            workers[i].self = i;
+            workers[i].chunk.next = workers[i].chunk.end = 0;
+            workers[i].failed = 0;
+        }
+
+        /* The calling thread is worker 0. If a thread cannot be started,
+         * its share is simply stolen by the others, as worker 0 does not
+         * return before every queue is empty */
+        for(started = 1; started < nthreads; ++started)
+            if(pthread_create(&threads[started], NULL, batch_thread, &workers[started]) != 0)
+                break;
+
+        batch_thread(&workers[0]);
+
+        for(i = 1; i < started; ++i)
+            pthread_join(threads[i], NULL);
+
+        for(i = 0; i < nthreads; ++i)
+        {
+            failed += workers[i].failed;
+            pthread_mutex_destroy(&queues[i].lock);
+        }
+
+        free(queues);
+        free(workers);
+        free(threads);
+
+        return failed;
+    }
+serial:
+#else
+    (void)nthreads;
+#endif
+
+    range.next = 0;
+    range.end = n;
+    return batch_run(&job, batch_next_serial, &range);
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright 2010 (c) Sascha Mueller <mailbox@saschamueller.com>
+ *
+ * This file is part of qhashpw.
+ *
+ * qhashpw is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * qhashpw is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with qhashpw.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Interfaces shared by the hashpw*.c files, not part of the API */
+
+#ifndef HASHPW_INTERNAL_H
+#define HASHPW_INTERNAL_H
+
+#include <stddef.h>
+
+#include "hashpw.h"
+
+/* maximum length of a string representation of an
+ * integer. Used to determine a good size for snprintf
+ * and for the maximum allowed size of integers for
+ * the tokenizer*/
+#define MAX_INT_REP_LEN	(3*65)
+
+/* maximum allowed string length for input strings.
+ * Only used for sanity checks */
+#define MAX_INPUT_LENGTH	1024
+
+/* Every value of PasswortOptions::hash less than
+ * this value will be allowed */
+#define MAX_HASH_VALUE          6
+
+/* Same for PasswordOptions::scheme */
+#define MAX_SCHEME_VALUE        2
+
+/* largest number of allowed characters (FLAGS_PRINT) */
+#define HASHPW_MAX_ALPHABET     92
+
+/* largest HMAC output of any algorithm */
+#define HASHPW_MAX_MD_SIZE      64
+
+/* size of a buffer for hashpw_gen_message */
+#define HASHPW_MESSAGE_SIZE     (MAX_INT_REP_LEN*2+MAX_INPUT_LENGTH*2+1)
+
+/* State of one password that is being generated. Every HMAC block
+ * depends only on seq, so the HMACs of several generators can be
+ * computed together and then fed to each of them. */
+struct hashpw_gen
+{
+    struct PasswordInput in;
+    char *result;               /* where the next character goes */
+    int seq;                    /* seq of the next HMAC block */
+    unsigned bytes;             /* HMAC output bytes consumed so far */
+
+    /* If FL_EVENDIST we wait until a character is not a "leading 0" */
+    int password_has_started;
+
+    /* number of characters to create or -1 if we don't know that
+     * number (i.e., !FL_EVENDIST and min != max) */
+    int state;
+
+    /* Needed to determine length value (if !FL_EVENDIST) */
+    unsigned char mask;
+
+    /* SCHEME_UNBIASED and SCHEME_STREAM: the unused part of the output so far is a number
+     * pool_v that is uniform in [0, pool_n) */
+    unsigned pool_v, pool_n;
+
+    /* the same with FL_EVENDIST: progress of the length selection
+     * (see select_length) */
+    int lenpos, lenphase, ones;
+
+    /* the same: the allowed characters in ascending order */
+    int nalpha;
+    char alphabet[HASHPW_MAX_ALPHABET];
+};
+
+/* Fill in from opt, the strings are not copied */
+void hashpw_input_from_options(struct PasswordInput *in, const struct PasswordOptions *opt);
+
+/* Check the input and start a password, returns 0 or an error code
+ * of getpw2. result is always zero terminated, but the caller has to
+ * make sure it has room for max+1 bytes. */
+int hashpw_gen_init(struct hashpw_gen *g, const struct PasswordInput *in, char *result);
+
+/* Has the password been completed? */
+#define hashpw_gen_done(g)      ((g)->state == 0)
+
+/* Write the message of the next HMAC block (and advance seq) to buf,
+ * which has room for HASHPW_MESSAGE_SIZE bytes. Returns its length,
+ * the message is not zero terminated. */
+size_t hashpw_gen_message(struct hashpw_gen *g, char *buf);
+
+/* Consume the output of the HMAC block created by the last call to
+ * hashpw_gen_message */
+void hashpw_gen_feed(struct hashpw_gen *g, const unsigned char *hmac, unsigned int len);
+
+/* Store the cost of the finished password g, which was created in result */
+void hashpw_gen_cost(const struct hashpw_gen *g, const char *result, struct PasswordCost *cost);
+
+/* Can key create passwords with the algorithm hash? */
+int hashpw_key_supports(const struct hashpw_key *key, int hash);
+
+/* HMAC of n messages with the algorithm hash, the i-th result goes to
+ * out + i*outstride, using the backend of key.
+ * Returns 0 on failure */
+int hashpw_key_hmac_many(const struct hashpw_key *key, int hash, int n,
+                         const unsigned char *const *msg, const size_t *len,
+                         unsigned char *out, size_t outstride, unsigned int *outlen);
+
+/* Number of messages hashpw_key_hmac_many computes with the algorithm
+ * hash in about the time of a single one (1 without multi-buffer kernels) */
+int hashpw_key_lanes(const struct hashpw_key *key, int hash);
+
+#endif // HASHPW_INTERNAL_H
@@ -0,0 +1,319 @@
+/*
+ * Copyright 2010 (c) Sascha Mueller <mailbox@saschamueller.com>
+ *
+ * This file is part of qhashpw.
+ *
+ * qhashpw is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * qhashpw is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with qhashpw.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <string.h>
+
+#include "digest.h"
+#include "hashpw.h"
+#include "hmac_mb.h"
+#include "secmem.h"
+
+/* Number of blocks of the inner message, which follows the
+ * (key ^ ipad) block: message, 0x80, 64 bit length */
+#define INNER_BLOCKS(len)       (((len)+9+DIGEST_BLOCK_SIZE-1)/DIGEST_BLOCK_SIZE)
+
+/* Put the length of the hashed data (including the key
+ * block) into the last two words of a block */
+static void put_length(int hash, uint64_t bytes, uint32_t *w)
+{
+    uint64_t bits = bytes*8;
+
+    if(digest_big_endian(hash))
+    {
+        w[14] = (uint32_t)(bits >> 32);
+        w[15] = (uint32_t)bits;
+    }
+     else
+    {
+        w[14] = (uint32_t)bits;
+        w[15] = (uint32_t)(bits >> 32);
+    }
+}
+
+/* Block b of the padded inner message of one lane */
+static void inner_block(int hash, const unsigned char *msg, size_t len, size_t b, uint32_t *w)
+{
+    unsigned char block[DIGEST_BLOCK_SIZE];
+    size_t off = b*DIGEST_BLOCK_SIZE;
+    size_t n = 0;
+
+    if(off < len)
+    {
+        n = len-off;
+        if(n > DIGEST_BLOCK_SIZE) n = DIGEST_BLOCK_SIZE;
+        memcpy(block, msg+off, n);
+    }
+    memset(block+n, 0, DIGEST_BLOCK_SIZE-n);
+
+    if(len >= off && len < off+DIGEST_BLOCK_SIZE) block[len-off] = 0x80;
+
+    digest_load_block(hash, block, w);
+
+    if(b == INNER_BLOCKS(len)-1) put_length(hash, DIGEST_BLOCK_SIZE+len, w);
+}
+
+/* The single block of the outer message (the inner digest ih).
+ * If ih is NULL, the digest words are left 0 */
+static void outer_block(int hash, const uint32_t *ih, uint32_t *w)
+{
+    unsigned int words = digest_size(hash)/4;
+
+    memset(w, 0, 16*sizeof(uint32_t));
+    if(ih) memcpy(w, ih, words*sizeof(uint32_t));
+    w[words] = digest_big_endian(hash) ? 0x80000000 : 0x80;
+    put_length(hash, DIGEST_BLOCK_SIZE+digest_size(hash), w);
+}
+
+/*******************************************************************/
+/** Kernels                                                       **/
+
+typedef void (*mb_hmac_fn)(const struct hmac_mb_key *k, int n,
+                           const unsigned char *const *msg, const size_t *len,
+                           unsigned char *out, size_t outstride);
+
+struct mb_kernel
+{
+    const char *name;
+    int lanes;
+    mb_hmac_fn hmac;
+};
+
+/* Fallback: one message after the other */
+static void hmac_scalar(const struct hmac_mb_key *k, int n,
+                        const unsigned char *const *msg, const size_t *len,
+                        unsigned char *out, size_t outstride)
+{
+    uint32_t h[DIGEST_MAX_WORDS], w[16];
+    int i;
+    size_t b;
+
+    for(i = 0; i < n; ++i)
+    {
+        memcpy(h, k->inner, sizeof(h));
+        for(b = 0; b < INNER_BLOCKS(len[i]); ++b)
+        {
+            inner_block(k->hash, msg[i], len[i], b, w);
+            digest_compress(k->hash, h, w);
+        }
+
+        outer_block(k->hash, h, w);
+        memcpy(h, k->outer, sizeof(h));
+        digest_compress(k->hash, h, w);
+
+        digest_store(k->hash, h, out + i*outstride);
+    }
+}
+
+static const struct mb_kernel kernel_scalar = { "scalar", 1, hmac_scalar };
+
+/* The wide hashes, from the digest contexts of k */
+static void hmac_wide(const struct hmac_mb_key *k, int n,
+                      const unsigned char *const *msg, const size_t *len,
+                      unsigned char *out, size_t outstride)
+{
+    struct digest_ctx c;
+    unsigned char ih[DIGEST_MAX_SIZE];
+    unsigned int ilen;
+    int i;
+
+    for(i = 0; i < n; ++i)
+    {
+        assert(k->hash != HASH_BLAKE2B || len[i] > 0);
+
+        c = k->inner_ctx;
+        digest_update(&c, msg[i], len[i]);
+        ilen = digest_final(&c, ih);
+
+        c = k->outer_ctx;
+        digest_update(&c, ih, ilen);
+        digest_final(&c, out + i*outstride);
+    }
+
+    memset(ih, 0, sizeof(ih));
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HMAC_MB_X86
+
+typedef uint32_t mb_vec4 __attribute__((vector_size(16)));
+typedef uint32_t mb_vec8 __attribute__((vector_size(32)));
+typedef uint32_t mb_vec16 __attribute__((vector_size(64)));
+
+#define MB_VEC          mb_vec4
+#define MB_LANES        4
+#define MB_FN(name)     mb_##name##_sse2
+#define MB_ATTR         __attribute__((target("sse2")))
+#include "hmac_mb_kernel.h"
+#undef MB_VEC
+#undef MB_LANES
+#undef MB_FN
+#undef MB_ATTR
+
+#define MB_VEC          mb_vec8
+#define MB_LANES        8
+#define MB_FN(name)     mb_##name##_avx2
+#define MB_ATTR         __attribute__((target("avx2")))
+#include "hmac_mb_kernel.h"
+#undef MB_VEC
+#undef MB_LANES
+#undef MB_FN
+#undef MB_ATTR
+
+#define MB_VEC          mb_vec16
+#define MB_LANES        16
+#define MB_FN(name)     mb_##name##_avx512
+#define MB_ATTR         __attribute__((target("avx512f")))
+#include "hmac_mb_kernel.h"
+#undef MB_VEC
+#undef MB_LANES
+#undef MB_FN
+#undef MB_ATTR
+
+static const struct mb_kernel kernel_sse2 = { "sse2", 4, mb_hmac_sse2 };
+static const struct mb_kernel kernel_avx2 = { "avx2", 8, mb_hmac_avx2 };
+static const struct mb_kernel kernel_avx512 = { "avx512", 16, mb_hmac_avx512 };
+
+#endif
+
+/* Best kernel first */
+static const struct mb_kernel *available_kernel(int i)
+{
+#ifdef HMAC_MB_X86
+    __builtin_cpu_init();
+
+    switch(i)
+    {
+    case 0: return __builtin_cpu_supports("avx512f") ? &kernel_avx512 : NULL;
+    case 1: return __builtin_cpu_supports("avx2") ? &kernel_avx2 : NULL;
+    case 2: return __builtin_cpu_supports("sse2") ? &kernel_sse2 : NULL;
+    case 3: return &kernel_scalar;
+    default: return NULL;
+    }
+#else
+    return i == 0 ? &kernel_scalar : NULL;
+#endif
+}
+
+#define MAX_KERNELS     4
+
+/* The kernel in use. Selecting the best one twice concurrently
+ * stores the same pointer, so no locking is done here */
+static const struct mb_kernel *current = NULL;
+
+static const struct mb_kernel *kernel(void)
+{
+    if(current == NULL) hmac_mb_select(NULL);
+    return current;
+}
+
+int hmac_mb_select(const char *name)
+{
+    int i;
+
+    for(i = 0; i < MAX_KERNELS; ++i)
+    {
+        const struct mb_kernel *k = available_kernel(i);
+        if(k != NULL && (name == NULL || strcmp(name, k->name) == 0))
+        {
+            current = k;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int hmac_mb_lanes(void)
+{
+    return kernel()->lanes;
+}
+
+const char *hmac_mb_kernel(void)
+{
+    return kernel()->name;
+}
+
+/*******************************************************************/
+/** HMAC                                                          **/
+
+int hmac_mb_key_init(struct hmac_mb_key *k, int hash, const void *key, size_t len)
+{
+    struct digest_ctx c;
+    unsigned char block[DIGEST_MAX_BLOCK_SIZE];
+    unsigned int bs;
+    unsigned int i;
+
+    if(!digest_supported(hash)) return 0;
+
+    k->hash = hash;
+    bs = digest_block_size(hash);
+
+    /* keys longer than one block are hashed first */
+    memset(block, 0, sizeof(block));
+    if(len > bs)
+    {
+        digest_init(&c, hash);
+        digest_update(&c, key, len);
+        digest_final(&c, block);
+    }
+     else memcpy(block, key, len);
+
+    for(i = 0; i < bs; ++i) block[i] ^= 0x36;
+    digest_init(&k->inner_ctx, hash);
+    digest_absorb_block(&k->inner_ctx, block);
+    memcpy(k->inner, k->inner_ctx.h, sizeof(k->inner));
+
+    for(i = 0; i < bs; ++i) block[i] ^= 0x36^0x5c;
+    digest_init(&k->outer_ctx, hash);
+    digest_absorb_block(&k->outer_ctx, block);
+    memcpy(k->outer, k->outer_ctx.h, sizeof(k->outer));
+
+    secmem_wipe(block, sizeof(block));
+    secmem_wipe(&c, sizeof(c));
+
+    return 1;
+}
+
+void hmac_mb_one(const struct hmac_mb_key *k, const unsigned char *msg, size_t len,
+                 unsigned char *out)
+{
+    if(digest_wide(k->hash))
+        hmac_wide(k, 1, &msg, &len, out, 0);
+    else
+        hmac_scalar(k, 1, &msg, &len, out, 0);
+}
+
+void hmac_mb(const struct hmac_mb_key *k, int n,
+             const unsigned char *const *msg, const size_t *len,
+             unsigned char *out, size_t outstride)
+{
+    const struct mb_kernel *kern = kernel();
+    int i;
+
+    if(digest_wide(k->hash))
+    {
+        hmac_wide(k, n, msg, len, out, outstride);
+        return;
+    }
+
+    for(i = 0; i < n; i += kern->lanes)
+        kern->hmac(k, n-i < kern->lanes ? n-i : kern->lanes,
+                   msg+i, len+i, out + i*outstride, outstride);
+}
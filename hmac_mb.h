@@ -0,0 +1,80 @@
+/*
+ * Copyright 2010 (c) Sascha Mueller <mailbox@saschamueller.com>
+ *
+ * This file is part of qhashpw.
+ *
+ * qhashpw is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * qhashpw is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with qhashpw.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HMAC_MB_H
+#define HMAC_MB_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "digest.h"
+
+/* Multi-buffer HMAC: computes many HMACs with the same key at once,
+ * one message per lane of a SIMD vector (4 lanes with SSE2, 8 with AVX2,
+ * 16 with AVX-512). The kernel is chosen at runtime from what the CPU
+ * supports; "scalar" works everywhere. The wide hashes (digest_wide)
+ * always use scalar code, one message after the other. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* HMAC key as chaining values after the (key ^ ipad) resp.
+ * (key ^ opad) block */
+struct hmac_mb_key
+{
+    int hash;
+    uint32_t inner[DIGEST_MAX_WORDS];
+    uint32_t outer[DIGEST_MAX_WORDS];
+
+    /* the same for the wide hashes, as digest contexts */
+    struct digest_ctx inner_ctx;
+    struct digest_ctx outer_ctx;
+};
+
+/* returns 0 if hash is not supported by digest.h */
+int hmac_mb_key_init(struct hmac_mb_key *k, int hash, const void *key, size_t len);
+
+/* Compute the HMACs of the n messages msg[i] (len[i] bytes each).
+ * The i-th result (digest_size(k->hash) bytes) is written to
+ * out + i*outstride. The messages of HASH_BLAKE2B must not be empty
+ * (see digest_absorb_block) */
+void hmac_mb(const struct hmac_mb_key *k, int n,
+             const unsigned char *const *msg, const size_t *len,
+             unsigned char *out, size_t outstride);
+
+/* HMAC of a single message with the scalar code, which is faster than
+ * any kernel with only one lane in use */
+void hmac_mb_one(const struct hmac_mb_key *k, const unsigned char *msg, size_t len,
+                 unsigned char *out);
+
+/* Number of lanes resp. name of the kernel in use */
+int hmac_mb_lanes(void);
+const char *hmac_mb_kernel(void);
+
+/* Use the kernel with the given name ("scalar", "sse2", "avx2", "avx512")
+ * or the best available one if name is NULL.
+ * Returns 0 if that kernel is not available on this machine/build. */
+int hmac_mb_select(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HMAC_MB_H
@@ -0,0 +1,104 @@
+/*
+ * Copyright 2010 (c) Sascha Mueller <mailbox@saschamueller.com>
+ *
+ * This file is part of qhashpw.
+ *
+ * qhashpw is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * qhashpw is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with qhashpw.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * One SIMD kernel of hmac_mb.c. Like digest_rounds.h, this file is
+ * included once per vector width. Define before including:
+ *   MB_VEC            GCC vector of MB_LANES uint32_t
+ *   MB_LANES          number of lanes
+ *   MB_FN(name)       name of this instance of function name
+ *   MB_ATTR           target attribute of the instruction set
+ */
+
+#define DIGEST_VEC      MB_VEC
+#define DIGEST_FN(name) MB_FN(name)
+#define DIGEST_ATTR     MB_ATTR
+#include "digest_rounds.h"
+#undef DIGEST_VEC
+#undef DIGEST_FN
+#undef DIGEST_ATTR
+
+static MB_ATTR void MB_FN(compress)(int hash, MB_VEC *h, const MB_VEC *w)
+{
+    switch(hash)
+    {
+    case HASH_RIPEMD160:    MB_FN(ripemd160)(h, w); break;
+    case HASH_SHA1:
+    case HASH_DSS1:         MB_FN(sha1)(h, w); break;
+    case HASH_MD5:          MB_FN(md5)(h, w); break;
+    case HASH_SHA256:       MB_FN(sha256)(h, w); break;
+    }
+}
+
+/* at most MB_LANES messages */
+static MB_ATTR void MB_FN(hmac)(const struct hmac_mb_key *k, int n,
+                                const unsigned char *const *msg, const size_t *len,
+                                unsigned char *out, size_t outstride)
+{
+    MB_VEC h[DIGEST_MAX_WORDS], nh[DIGEST_MAX_WORDS], w[16];
+    MB_VEC nblocks, mask;
+    MB_VEC zero = { 0 };
+    uint32_t lw[16];
+    size_t b, maxblocks = 0;
+    int words = digest_size(k->hash)/4;
+    int lane, j;
+
+    nblocks = zero;
+    for(lane = 0; lane < n; ++lane)
+    {
+        nblocks[lane] = INNER_BLOCKS(len[lane]);
+        if(INNER_BLOCKS(len[lane]) > maxblocks) maxblocks = INNER_BLOCKS(len[lane]);
+    }
+
+    for(j = 0; j < words; ++j) h[j] = zero + k->inner[j];
+
+    /* Lanes with shorter messages keep their chaining value
+     * once all of their blocks have been processed */
+    for(b = 0; b < maxblocks; ++b)
+    {
+        for(lane = 0; lane < MB_LANES; ++lane)
+        {
+            if(lane < n && b < INNER_BLOCKS(len[lane]))
+                inner_block(k->hash, msg[lane], len[lane], b, lw);
+            else
+                memset(lw, 0, sizeof(lw));
+
+            for(j = 0; j < 16; ++j) w[j][lane] = lw[j];
+        }
+
+        for(j = 0; j < words; ++j) nh[j] = h[j];
+        MB_FN(compress)(k->hash, nh, w);
+
+        mask = (MB_VEC)(nblocks > zero + (uint32_t)b);
+        for(j = 0; j < words; ++j) h[j] = (nh[j] & mask) | (h[j] & ~mask);
+    }
+
+    /* The outer message is the inner digest, whose words equal the
+     * chaining value in both byte orders */
+    outer_block(k->hash, NULL, lw);
+    for(j = 0; j < 16; ++j) w[j] = j < words ? h[j] : zero + lw[j];
+    for(j = 0; j < words; ++j) h[j] = zero + k->outer[j];
+    MB_FN(compress)(k->hash, h, w);
+
+    for(lane = 0; lane < n; ++lane)
+    {
+        for(j = 0; j < words; ++j) lw[j] = h[j][lane];
+        digest_store(k->hash, lw, out + lane*outstride);
+    }
+}
@@ -34,7 +34,9 @@
 
 #include "accountsetview.h"
 #include "mainwindow.h"
+#include "passwordbatch.h"
 #include "tokenizer.h"
+#include "vaultaudit.h"
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -79,6 +81,16 @@ MainWindow::MainWindow(QWidget *parent)
     toClipboardAction->setToolTip(tr("Copy the selected password to the clipboard"));
     // enabled will be set in updateCurrentSet
 
+    costAction = new QAction(tr("Generation &Cost..."), this);
+    costAction->setToolTip(tr("Show the accounts that are most expensive to create"));
+    connect(costAction, SIGNAL(triggered()), SLOT(costActionTriggered()));
+    // enabled will be set in updateCurrentSet
+
+    auditAction = new QAction(tr("Password &Audit..."), this);
+    auditAction->setToolTip(tr("Find accounts that get the same password"));
+    connect(auditAction, SIGNAL(triggered()), SLOT(auditActionTriggered()));
+    // enabled will be set in updateCurrentSet
+
     viewActions = new QActionGroup(this);
     toTreeViewAction = new QAction(QIcon(":/img/view_list_tree.svgz"), tr("Tree View"), viewActions);
     toListViewAction = new QAction(QIcon(":/img/view_list_text.svgz"), tr("List View"), viewActions);
@@ -136,6 +148,8 @@ MainWindow::MainWindow(QWidget *parent)
 
     QMenu *accountMenu = menuBar()->addMenu(tr("&Account"));
     accountMenu->addAction(toClipboardAction);
+    accountMenu->addAction(costAction);
+    accountMenu->addAction(auditAction);
 
     menuBar()->addSeparator();
     QMenu *helpMenu = menuBar()->addMenu(tr("&Help"));
@@ -242,6 +256,32 @@ void MainWindow::toClipboardActionTriggered()
     s->copyCurrentPassword();
 }
 
+void MainWindow::auditActionTriggered()
+{
+    AccountSetView *s = center->currentSet();
+    Q_ASSERT(s != 0);
+    Q_ASSERT(!s->isLocked());
+    VaultAudit audit(s->accounts());
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    audit.run(s->key());
+    QApplication::restoreOverrideCursor();
+    QMessageBox(QMessageBox::Information,
+                tr("Password audit"),
+                audit.report(),
+                QMessageBox::Ok).exec();
+}
+
+void MainWindow::costActionTriggered()
+{
+    AccountSetView *s = center->currentSet();
+    Q_ASSERT(s != 0);
+    PasswordBatch batch(s->accounts());
+    QMessageBox(QMessageBox::Information,
+                tr("Generation cost"),
+                batch.costReport(),
+                QMessageBox::Ok).exec();
+}
+
 void MainWindow::updateCurrentSet(int)
 {
     bool enabled = center->count() > 0 && center->currentSet() != 0;
@@ -271,6 +311,8 @@ void MainWindow::updateCurrentSet(int)
     fileWriteActions->setEnabled(enabled);
 
     toClipboardAction->setEnabled(!locked);
+    costAction->setEnabled(enabled);
+    auditAction->setEnabled(!locked);
     viewActions->setEnabled(enabled);
     toTreeViewAction->setChecked(enabled && center->currentSet()->isTreeView());
     toTreeViewAction->setChecked(enabled && center->currentSet()->isListView());
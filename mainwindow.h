@@ -44,6 +44,8 @@ public:
     void addAccountSet(const QString &filename);
 
 private slots:
+    void auditActionTriggered();
+    void costActionTriggered();
     void filter();
     void lockActionToggled(bool state);
     void open();
@@ -64,6 +66,8 @@ private:
     QAction *lockAction;
     QList<QAction*> recentFileActions;
     QAction *toClipboardAction;
+    QAction *costAction;
+    QAction *auditAction;
     QAction *toTreeViewAction;
     QAction *toListViewAction;
     QActionGroup *viewActions;
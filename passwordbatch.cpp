@@ -0,0 +1,240 @@
+/*
+ * Copyright 2010 (c) Sascha Mueller <mailbox@saschamueller.com>
+ *
+ * This file is part of qhashpw.
+ *
+ * qhashpw is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * qhashpw is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with qhashpw.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+
+#include <QtCore/QPair>
+#include <QtCore/QtAlgorithms>
+
+#include "accountset.h"
+#include "digest.h"
+#include "passwordbatch.h"
+#include "secmem.h"
+
+// Longest password a batch makes room for. Every entry gets a slot of
+// the same size, so one account with a huge max (FL_EVENDIST) would
+// make all of them that large; such an entry is created on its own.
+#define BATCH_MAX_LENGTH        1024
+
+PasswordBatch::PasswordBatch(const AccountSet *as)
+: results_(0), stride_(1)
+{
+    for(int i = 0; i < as->rowCount(); ++i)
+        accounts_.append(as->at(i));
+    resolve();
+}
+
+PasswordBatch::PasswordBatch(const QList<Account> &accounts)
+: accounts_(accounts), results_(0), stride_(1)
+{
+    resolve();
+}
+
+PasswordBatch::~PasswordBatch()
+{
+    secmem_free(results_);
+    foreach(char *pw, large_)
+        secmem_free(pw);
+}
+
+PasswordInput PasswordBatch::input(const Account &a, QByteArray *salt, QByteArray *descr)
+{
+    PasswordInput in;
+
+    // Fill in the options the same way AccountSetView::getPassword does
+    *salt = a.salt().toLocal8Bit();
+    *descr = (a.site() + a.user()).toLocal8Bit();
+
+    init_PasswordInput(&in);
+    in.salt = salt->constData();
+    in.saltlen = salt->size();
+    in.descr = descr->constData();
+    in.descrlen = descr->size();
+    in.num = a.num();
+    in.min = a.min();
+    in.max = a.max();
+    in.flags = a.flags();
+    in.hash = a.algo();
+    in.scheme = a.scheme() == Account::INVALID_INT_FIELD ? SCHEME_REJECT : a.scheme();
+    return in;
+}
+
+void PasswordBatch::resolve()
+{
+    opts_.resize(accounts_.count());
+
+    for(int i = 0; i < accounts_.count(); ++i)
+    {
+        QByteArray salt, descr;
+        PasswordInput in = input(accounts_[i], &salt, &descr);
+        PasswordOptions &opt = opts_[i];
+
+        strings_.append(salt);
+        strings_.append(descr);
+
+        init_PasswordOptions(&opt);
+        opt.salt = strings_[2*i].constData();
+        opt.descr = strings_[2*i+1].constData();
+        opt.num = in.num;
+        opt.min = in.min;
+        opt.max = in.max;
+        opt.flags = in.flags;
+        opt.hash = in.hash;
+        opt.scheme = in.scheme;
+
+        if(in.max >= 0 && in.max < BATCH_MAX_LENGTH && size_t(in.max) >= stride_)
+            stride_ = in.max+1;
+    }
+}
+
+int PasswordBatch::generate(const struct hashpw_key *key, int threads)
+{
+    secmem_free(results_);
+    foreach(char *pw, large_)
+        secmem_free(pw);
+    large_.clear();
+
+    size_t n = opts_.count();
+    results_ = n > size_t(-1)/stride_ ? 0 : (char *)secmem_alloc(n*stride_);
+    status_.resize(opts_.count());
+    costs_.resize(opts_.count());
+
+    if(results_ == 0)
+    {
+        status_.fill(-9);
+        costs_.fill(PasswordCost());
+        return opts_.count();
+    }
+
+    int failed = getpw2_batch(key, opts_.constData(), opts_.count(),
+                              results_, stride_, status_.data(), costs_.data(), threads);
+
+    // The batch leaves the ones that do not fit into a slot to us (-5)
+    for(int i = 0; i < opts_.count(); ++i)
+    {
+        const PasswordOptions &opt = opts_[i];
+        if(opt.max < BATCH_MAX_LENGTH) continue;
+
+        char *pw = (char *)secmem_alloc(size_t(opt.max)+1);
+        if(pw == 0)
+        {
+            status_[i] = -9;
+            continue;
+        }
+        large_.insert(i, pw);
+
+        PasswordInput in;
+        init_PasswordInput(&in);
+        in.salt = opt.salt;
+        in.saltlen = std::strlen(opt.salt);
+        in.descr = opt.descr;
+        in.descrlen = std::strlen(opt.descr);
+        in.num = opt.num;
+        in.min = opt.min;
+        in.max = opt.max;
+        in.flags = opt.flags;
+        in.hash = opt.hash;
+        in.scheme = opt.scheme;
+
+        status_[i] = getpw3_cost(key, &in, pw, size_t(opt.max)+1, &costs_[i]);
+        if(status_[i] == 0) --failed;
+    }
+
+    return failed;
+}
+
+const char *PasswordBatch::result(int i) const
+{
+    const char *pw = large_.value(i);
+    return pw != 0 ? pw : results_ + size_t(i)*stride_;
+}
+
+QByteArray PasswordBatch::passwordDigest(int i) const
+{
+    const char *pw = result(i);
+    struct digest_ctx c;
+    QByteArray d(digest_size(HASH_SHA256), 0);
+
+    digest_init(&c, HASH_SHA256);
+    digest_update(&c, pw, std::strlen(pw));
+    digest_final(&c, reinterpret_cast<unsigned char *>(d.data()));
+    secmem_wipe(&c, sizeof(c));
+    return d;
+}
+
+PasswordCost PasswordBatch::expectedCost(int i) const
+{
+    const PasswordOptions &opt = opts_[i];
+    PasswordInput in;
+    PasswordCost cost;
+
+    init_PasswordInput(&in);
+    in.min = opt.min;
+    in.max = opt.max;
+    in.flags = opt.flags;
+    in.hash = opt.hash;
+    in.scheme = opt.scheme;
+
+    hashpw_estimate(&in, &cost); // leaves cost zero on error
+    return cost;
+}
+
+QList<int> PasswordBatch::mostExpensive(int n) const
+{
+    // sorted by descending cost, equal costs in account order
+    QList<QPair<double, int> > order;
+    for(int i = 0; i < count(); ++i)
+        order.append(qMakePair(-expectedCost(i).blocks, i));
+    qStableSort(order);
+
+    QList<int> result;
+    for(int i = 0; i < qMin(n, order.count()); ++i)
+        result.append(order[i].second);
+    return result;
+}
+
+QString PasswordBatch::costReport(int n) const
+{
+    double total = 0;
+    for(int i = 0; i < count(); ++i)
+        total += expectedCost(i).blocks;
+
+    QString report = tr("%1 accounts, %2 HMAC blocks expected\n")
+                     .arg(count())
+                     .arg(total, 0, 'f', 1);
+
+    bool generated = costs_.count() == count();
+
+    foreach(int i, mostExpensive(n))
+    {
+        const Account &a = accounts_[i];
+        PasswordCost e = expectedCost(i);
+
+        report += tr("\n%1@%2: %3 blocks, %4% of the bytes rejected")
+                  .arg(a.user())
+                  .arg(a.site())
+                  .arg(e.blocks, 0, 'f', 1)
+                  .arg(e.bytes > 0 ? 100*e.rejected/e.bytes : 0, 0, 'f', 0);
+
+        if(generated && status_[i] == 0)
+            report += tr(" (last time %1)").arg(costs_[i].blocks);
+    }
+
+    return report;
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright 2010 (c) Sascha Mueller <mailbox@saschamueller.com>
+ *
+ * This file is part of qhashpw.
+ *
+ * qhashpw is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * qhashpw is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with qhashpw.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PASSWORDBATCH_H
+#define PASSWORDBATCH_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+#include "account.h"
+#include "hashpw.h"
+
+class AccountSet;
+
+// Creates the passwords of many accounts at once (see getpw2_batch)
+class PasswordBatch
+{
+    Q_DECLARE_TR_FUNCTIONS(PasswordBatch)
+
+public:
+    // Takes the resolved accounts of the current filter of as
+    PasswordBatch(const AccountSet *as);
+    PasswordBatch(const QList<Account> &accounts);
+    ~PasswordBatch();
+
+    inline int count() const { return accounts_.count(); }
+    inline const Account &account(int i) const { return accounts_[i]; }
+
+    // The input of the password of the resolved account a, the one
+    // place that maps an Account to the library. in.salt and in.descr
+    // point into *salt and *descr.
+    static PasswordInput input(const Account &a, QByteArray *salt, QByteArray *descr);
+
+    // Create all passwords, using threads threads (<= 0: one per CPU)
+    // Returns the number of passwords that could not be created
+    // (a max of more than 1023 characters is created on its own,
+    // after the others)
+    int generate(const struct hashpw_key *key, int threads = 0);
+
+    // Result of the last call to generate()
+    inline QString password(int i) const { return QString(result(i)); }
+    inline int status(int i) const { return status_[i]; }
+
+    // SHA-256 of password(i), which compares them without copying
+    // them out of locked memory
+    QByteArray passwordDigest(int i) const;
+
+    // The options entry i is created with (salt and descr point into
+    // the batch)
+    inline const PasswordOptions &options(int i) const { return opts_[i]; }
+    inline const PasswordCost &cost(int i) const { return costs_[i]; }
+
+    // Expected cost of entry i (see hashpw_estimate), zero if its
+    // options are invalid. Does not need the main password.
+    PasswordCost expectedCost(int i) const;
+
+    // The indices of the (at most) n entries with the highest
+    // expected number of HMAC blocks, most expensive first
+    QList<int> mostExpensive(int n) const;
+
+    // Human readable report on the expected total cost and the n most
+    // expensive entries, with their actual cost if generate() was called
+    QString costReport(int n = 10) const;
+
+private:
+    void resolve();
+    const char *result(int i) const;
+
+    QList<Account> accounts_;
+    QList<QByteArray> strings_;     // salt and description of each entry of opts_
+    QVector<PasswordOptions> opts_;
+    QVector<int> status_;
+    QVector<PasswordCost> costs_;
+    char *results_;                 // in locked memory (see secmem.h), 0 before generate()
+    size_t stride_;                 // room for the longest password up to BATCH_MAX_LENGTH
+    QHash<int, char *> large_;      // the longer ones by entry, also locked
+
+    Q_DISABLE_COPY(PasswordBatch)
+};
+
+#endif // PASSWORDBATCH_H
@@ -0,0 +1,188 @@
+/*
+ * Copyright 2010 (c) Sascha Mueller <mailbox@saschamueller.com>
+ *
+ * This file is part of qhashpw.
+ *
+ * qhashpw is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * qhashpw is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with qhashpw.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+
+#include <QtCore/QMutexLocker>
+
+#include "passwordbatch.h"
+#include "passwordcache.h"
+#include "secmem.h"
+
+// Accounts per warm-up task. Small enough that the workers share the
+// visible rows, large enough that the tasks are not mostly overhead.
+#define WARMUP_CHUNK    16
+
+class PasswordCache::WarmUp : public ScheduledTask
+{
+public:
+    WarmUp(PasswordCache *c, const struct hashpw_key *k, const Account &d,
+           const CancelToken &token)
+    : ScheduledTask(token), cache(c), key(k), defaults(d) {}
+
+    PasswordCache *cache;           // stop() waits for the task
+    const struct hashpw_key *key;
+    Account defaults;
+    QList<Account> todo;            // not resolved yet
+
+protected:
+    void run();
+};
+
+// One job after the other, so a single expensive account delays stop()
+// by a few blocks at most
+void PasswordCache::WarmUp::run()
+{
+    for(int i = 0; i < todo.count() && !token().isCancelled(); ++i)
+    {
+        Account a = todo[i];
+        Input input;
+
+        a.fillAccount(defaults);
+        resolve(a, &input);
+
+        {
+            QMutexLocker lock(&cache->mutex_);
+            if(cache->entries_.contains(input.id)) continue;
+        }
+
+        struct hashpw_job *job = hashpw_job_new(key, &input.in, 0);
+        if(job == 0) continue;  // invalid account, shown when it is asked for
+
+        if(hashpw_job_run(job, 0, token().flag()) == 0)
+        {
+            const char *pw = hashpw_job_result(job);
+            cache->store(input.id, pw, std::strlen(pw));
+        }
+
+        hashpw_job_free(job);
+    }
+}
+
+PasswordCache::PasswordCache()
+{
+}
+
+PasswordCache::~PasswordCache()
+{
+    clear();
+}
+
+void PasswordCache::resolve(const Account &a, Input *input)
+{
+    input->in = PasswordBatch::input(a, &input->salt, &input->descr);
+    const struct PasswordInput &in = input->in;
+
+    // every input that goes into the password, the strings with their
+    // length so that no two accounts can have the same id
+    input->id = QByteArray::number(input->salt.size()) + ':' + input->salt +
+                QByteArray::number(input->descr.size()) + ':' + input->descr +
+                QString("%1:%2:%3:%4:%5:%6").arg(in.num).arg(in.min).arg(in.max)
+                .arg(in.flags).arg(in.hash).arg(in.scheme).toLatin1();
+}
+
+bool PasswordCache::find(const Account &a, QString *password) const
+{
+    Input input;
+    resolve(a, &input);
+
+    QMutexLocker lock(&mutex_);
+    const char *pw = entries_.value(input.id);
+    if(pw == 0) return false;
+
+    *password = QString(pw);
+    return true;
+}
+
+void PasswordCache::insert(const Account &a, const QString &password)
+{
+    Input input;
+    resolve(a, &input);
+
+    QByteArray b = password.toLatin1();
+    store(input.id, b.constData(), b.size());
+    secmem_wipe(b.data(), b.size());
+}
+
+void PasswordCache::store(const QByteArray &id, const char *password, size_t len)
+{
+    QMutexLocker lock(&mutex_);
+    if(entries_.contains(id)) return;
+
+    char *pw = (char *)secmem_alloc(len+1);
+    if(pw == 0) return;     // then it is created again next time
+
+    std::memcpy(pw, password, len);
+    entries_.insert(id, pw);
+}
+
+void PasswordCache::warmUp(const struct hashpw_key *key, const QList<Account> &accounts,
+                           const Account &defaults)
+{
+    // Called again while the user types, so only the tasks that are
+    // still running are kept for stop(), the others are finished
+    warmToken_.cancel();
+
+    QList<QFuture<void> > running;
+    foreach(QFuture<void> f, warming_)
+        if(!f.isFinished()) running.append(f);
+    warming_ = running;
+
+    warmToken_ = CancelToken();
+    WarmUp *task = 0;
+
+    foreach(const Account &a, accounts)
+    {
+        if(task == 0) task = new WarmUp(this, key, defaults, warmToken_);
+        task->todo.append(a);
+
+        if(task->todo.count() == WARMUP_CHUNK)
+        {
+            warming_.append(task->future());
+            TaskScheduler::instance()->submit(task, TaskScheduler::Background);
+            task = 0;
+        }
+    }
+
+    if(task != 0)
+    {
+        warming_.append(task->future());
+        TaskScheduler::instance()->submit(task, TaskScheduler::Background);
+    }
+}
+
+void PasswordCache::stop()
+{
+    warmToken_.cancel();
+
+    // the tasks that did not start are dropped right away
+    foreach(QFuture<void> f, warming_)
+        f.waitForFinished();
+    warming_.clear();
+}
+
+void PasswordCache::clear()
+{
+    stop();
+
+    QMutexLocker lock(&mutex_);
+    foreach(char *pw, entries_)
+        secmem_free(pw);    // wipes it
+    entries_.clear();
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright 2010 (c) Sascha Mueller <mailbox@saschamueller.com>
+ *
+ * This file is part of qhashpw.
+ *
+ * qhashpw is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * qhashpw is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with qhashpw.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PASSWORDCACHE_H
+#define PASSWORDCACHE_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QFuture>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+
+#include "account.h"
+#include "hashpw.h"
+#include "taskscheduler.h"
+
+// The passwords created since the account set was unlocked, kept in
+// locked memory (see secmem.h), so showing or copying one again is
+// instant. An entry belongs to the resolved generation inputs of an
+// account, not to a row, so it survives filtering.
+class PasswordCache
+{
+public:
+    PasswordCache();
+    ~PasswordCache();       // see clear()
+
+    // Store the password of a in password and return true if it is known
+    bool find(const Account &a, QString *password) const;
+    void insert(const Account &a, const QString &password);
+
+    // Create the passwords of accounts that are not known yet with
+    // background tasks of the TaskScheduler, roughly in the order of the
+    // list (so the rows the user sees come first). The accounts are
+    // resolved with defaults and looked up by the tasks, not here.
+    // A warm-up that is still running is cancelled without waiting for it.
+    // key must stay valid until stop() or clear().
+    void warmUp(const struct hashpw_key *key, const QList<Account> &accounts,
+                const Account &defaults);
+
+    // Stop the warm-up and wait until it does not use the key anymore
+    void stop();
+
+    // stop() and wipe all passwords
+    void clear();
+
+private:
+    // An account resolved with PasswordBatch::input, with the strings
+    // owned by the entry (in.salt and in.descr point into it, so it is
+    // not copied)
+    struct Input
+    {
+        QByteArray id;
+        QByteArray salt, descr;
+        struct PasswordInput in;
+    };
+
+    class WarmUp;
+    friend class WarmUp;
+
+    static void resolve(const Account &a, Input *input);
+    void store(const QByteArray &id, const char *password, size_t len);
+
+    mutable QMutex mutex_;          // entries_ is filled by the warm-up tasks
+    QHash<QByteArray, char *> entries_;
+    CancelToken warmToken_;
+    QList<QFuture<void> > warming_;
+
+    Q_DISABLE_COPY(PasswordCache)
+};
+
+#endif // PASSWORDCACHE_H
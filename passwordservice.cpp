@@ -0,0 +1,133 @@
+/*
+ * Copyright 2010 (c) Sascha Mueller <mailbox@saschamueller.com>
+ *
+ * This file is part of qhashpw.
+ *
+ * qhashpw is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * qhashpw is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with qhashpw.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtCore/QByteArray>
+#include <QtCore/QTimer>
+
+#include "hashpw.h"
+#include "passwordbatch.h"
+#include "passwordservice.h"
+
+class PasswordService::Task : public ScheduledTask
+{
+public:
+    Task(PasswordService *s, int i, struct hashpw_job *j)
+    : service(s), id(i), job(j), ret(-9) {}
+    ~Task() { hashpw_job_free(job); }
+
+    PasswordService *service;       // 0 once the service is gone
+    int id;
+    struct hashpw_job *job;
+    int ret;
+
+protected:
+    void run() { ret = hashpw_job_run(job, 0, token().flag()); }
+    void finished() { if(service) service->finished(this); }
+};
+
+PasswordService::PasswordService(QObject *parent)
+: QObject(parent), key_(0), nextId_(1)
+{
+}
+
+PasswordService::~PasswordService()
+{
+    cancelAll();
+
+    // the scheduler deletes them later
+    foreach(Task *t, tasks_)
+        t->service = 0;
+}
+
+void PasswordService::setKey(const struct hashpw_key *key)
+{
+    if(key != key_) cancelAll();
+    key_ = key;
+}
+
+int PasswordService::request(const Account &a)
+{
+    int id = nextId_++;
+    int error = -9;
+    struct hashpw_job *job = 0;
+
+    if(key_ != 0)
+    {
+        // the job copies the strings
+        QByteArray salt, descr;
+        struct PasswordInput in = PasswordBatch::input(a, &salt, &descr);
+
+        job = hashpw_job_new(key_, &in, &error);
+    }
+
+    if(job == 0)
+    {
+        // reported from the event loop like every other result
+        failures_.append(qMakePair(id, error));
+        QTimer::singleShot(0, this, SLOT(failRequest()));
+        return id;
+    }
+
+    Task *t = new Task(this, id, job);
+    tasks_.insert(id, t);
+    TaskScheduler::instance()->submit(t, TaskScheduler::Interactive);
+
+    return id;
+}
+
+QFuture<void> PasswordService::future(int id) const
+{
+    Task *t = tasks_.value(id);
+    return t ? t->future() : QFuture<void>();
+}
+
+void PasswordService::cancel(int id)
+{
+    Task *t = tasks_.value(id);
+    if(t) t->token().cancel();
+}
+
+void PasswordService::cancelAll()
+{
+    foreach(Task *t, tasks_)
+        t->token().cancel();
+
+    // each of them stops within a few blocks
+    foreach(Task *t, tasks_)
+        t->future().waitForFinished();
+}
+
+// in the GUI thread, the scheduler deletes t afterwards
+void PasswordService::finished(Task *t)
+{
+    tasks_.remove(t->id);
+
+    if(t->token().isCancelled())
+        emit cancelled(t->id);  // even if it was done anyway
+    else if(t->ret == 0)
+        emit ready(t->id, QString(hashpw_job_result(t->job)));
+    else
+        emit failed(t->id, t->ret);
+}
+
+void PasswordService::failRequest()
+{
+    QPair<int, int> f = failures_.takeFirst();
+    emit failed(f.first, f.second);
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright 2010 (c) Sascha Mueller <mailbox@saschamueller.com>
+ *
+ * This file is part of qhashpw.
+ *
+ * qhashpw is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * qhashpw is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with qhashpw.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PASSWORDSERVICE_H
+#define PASSWORDSERVICE_H
+
+#include <QtCore/QFuture>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QObject>
+#include <QtCore/QPair>
+#include <QtCore/QString>
+
+#include "account.h"
+#include "taskscheduler.h"
+
+struct hashpw_job;
+struct hashpw_key;
+
+// Creates passwords as interactive tasks of the TaskScheduler, so the
+// GUI thread never waits for an expensive account. The results come
+// back as signals in the GUI thread.
+class PasswordService : public QObject
+{
+    Q_OBJECT
+
+public:
+    PasswordService(QObject *parent = 0);
+    ~PasswordService();     // cancels and waits for all requests
+
+    // Key for the requests from now on, 0 to stop all of them (see
+    // cancelAll). The key must stay valid until it is replaced.
+    void setKey(const struct hashpw_key *key);
+
+    // Start the password for a and return the id of the request.
+    // Exactly one of ready, failed or cancelled is emitted for it later
+    // (never from within request).
+    int request(const Account &a);
+
+    // The future of a running request (invalid once it is done), which
+    // finishes when no thread works on it anymore. The password comes
+    // with the signals.
+    QFuture<void> future(int id) const;
+
+    // Stop a request, it emits cancelled. Unknown ids are ignored
+    void cancel(int id);
+
+    // Stop all requests and wait until no thread uses the key anymore
+    void cancelAll();
+
+signals:
+    void ready(int id, const QString &password);
+    void failed(int id, int error);
+    void cancelled(int id);
+
+private slots:
+    void failRequest();
+
+private:
+    class Task;
+    friend class Task;
+
+    void finished(Task *t);
+
+    const struct hashpw_key *key_;
+    int nextId_;
+    QHash<int, Task *> tasks_;          // owned by the scheduler
+    QList<QPair<int, int> > failures_;  // id, error of invalid requests
+};
+
+#endif // PASSWORDSERVICE_H
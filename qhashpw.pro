@@ -6,18 +6,49 @@ TEMPLATE = app
 SOURCES += main.cpp \
     mainwindow.cpp \
     tokenizer.cpp \
+    tokscan.c \
     account.cpp \
     hashpw.c \
+    hashpw_batch.c \
+    digest.c \
+    chacha20.c \
+    hmac_mb.c \
+    secmem.c \
     accountset.cpp \
     mytabwidget.cpp \
-    accountsetview.cpp
+    accountsetview.cpp \
+    passwordbatch.cpp \
+    passwordcache.cpp \
+    passwordservice.cpp \
+    taskscheduler.cpp \
+    vaultaudit.cpp
 HEADERS += mainwindow.h \
     tokenizer.h \
+    tokscan.h \
     account.h \
     hashpw.h \
+    hashpw_internal.h \
+    digest.h \
+    chacha20.h \
+    digest_rounds.h \
+    hmac_mb.h \
+    hmac_mb_kernel.h \
+    secmem.h \
     accountset.h \
     mytabwidget.h \
-    accountsetview.h
+    accountsetview.h \
+    passwordbatch.h \
+    passwordcache.h \
+    passwordservice.h \
+    taskscheduler.h \
+    vaultaudit.h
 FORMS += 
 RESOURCES = qhashpw.qrc
-LIBS += -lssl
+# "qmake CONFIG+=nossl" builds without OpenSSL,
+# using only the builtin hash backend
+nossl {
+    DEFINES += HASHPW_NO_OPENSSL
+} else {
+    LIBS += -lssl -lcrypto
+}
+unix:LIBS += -lpthread -lm
@@ -0,0 +1,217 @@
+/*
+ * Copyright 2010 (c) Sascha Mueller <mailbox@saschamueller.com>
+ *
+ * This file is part of qhashpw.
+ *
+ * qhashpw is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * qhashpw is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with qhashpw.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define SECMEM_MMAP
+#endif
+
+#ifndef HASHPW_NO_THREADS
+#include <pthread.h>
+#endif
+
+#include "secmem.h"
+
+/* Blocks of up to SECMEM_MAX_BLOCK bytes (with the header) come from
+ * slabs of SECMEM_SLAB bytes, each of them split into blocks of one
+ * size class: 64, 128, ..., SECMEM_MAX_BLOCK. Larger ones get pages
+ * of their own. */
+#define SECMEM_SLAB             (64*1024)
+#define SECMEM_MIN_SHIFT        6
+#define SECMEM_CLASSES          9
+#define SECMEM_MAX_BLOCK        (1 << (SECMEM_MIN_SHIFT+SECMEM_CLASSES-1))
+
+/* In front of every block, padded to SECMEM_HEAD bytes so the
+ * user part is 16 byte aligned */
+struct secmem_head
+{
+    size_t size;                /* of the whole block or mapping */
+    int cls;                    /* size class or -1 for own pages */
+};
+
+#define SECMEM_HEAD             16
+
+/* A free block is kept zeroed except for the link to the next one,
+ * which is at the start of the user part */
+#define NEXT(h)         (*(struct secmem_head **)((char *)(h) + SECMEM_HEAD))
+
+static struct secmem_head *free_list[SECMEM_CLASSES];
+static int all_locked = 1;
+
+#ifndef HASHPW_NO_THREADS
+static pthread_mutex_t secmem_lock = PTHREAD_MUTEX_INITIALIZER;
+#define LOCK()          pthread_mutex_lock(&secmem_lock)
+#define UNLOCK()        pthread_mutex_unlock(&secmem_lock)
+#else
+#define LOCK()
+#define UNLOCK()
+#endif
+
+/* A plain memset before free() may be dropped by the compiler */
+static void *(*const volatile wipe_fn)(void *, int, size_t) = memset;
+
+void secmem_wipe(void *p, size_t size)
+{
+    if(p != NULL && size) wipe_fn(p, 0, size);
+}
+
+/* size bytes of zeroed, locked pages (size is a multiple of the page size) */
+static void *pages_alloc(size_t size)
+{
+    void *p;
+
+#if defined(SECMEM_MMAP)
+    p = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if(p == MAP_FAILED) return NULL;
+
+#if defined(MADV_DONTDUMP)
+    madvise(p, size, MADV_DONTDUMP);
+#elif defined(MADV_NOCORE)
+    madvise(p, size, MADV_NOCORE);
+#endif
+    if(mlock(p, size) != 0) all_locked = 0;
+#elif defined(_WIN32)
+    p = VirtualAlloc(NULL, size, MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE);
+    if(p == NULL) return NULL;
+    if(!VirtualLock(p, size)) all_locked = 0;
+#else
+    p = calloc(1, size);
+    all_locked = 0;
+#endif
+
+    return p;
+}
+
+static void pages_free(void *p, size_t size)
+{
+#if defined(SECMEM_MMAP)
+    munlock(p, size);
+    munmap(p, size);
+#elif defined(_WIN32)
+    VirtualUnlock(p, size);
+    VirtualFree(p, 0, MEM_RELEASE);
+#else
+    (void)size;
+    free(p);
+#endif
+}
+
+static size_t page_size(void)
+{
+#if defined(SECMEM_MMAP)
+    long n = sysconf(_SC_PAGESIZE);
+    return n > 0 ? (size_t)n : 4096;
+#else
+    return 4096;
+#endif
+}
+
+/* Split a new slab into free blocks of class cls, call with the lock held */
+static int grow(int cls)
+{
+    size_t bs = (size_t)1 << (SECMEM_MIN_SHIFT+cls);
+    char *slab = (char *)pages_alloc(SECMEM_SLAB);
+    size_t off;
+
+    if(slab == NULL) return 0;
+
+    // slabs are never returned, their blocks are wiped when freed
+    for(off = SECMEM_SLAB; off >= bs; off -= bs)
+    {
+        struct secmem_head *h = (struct secmem_head *)(slab + off - bs);
+        h->size = bs;
+        h->cls = cls;
+        NEXT(h) = free_list[cls];
+        free_list[cls] = h;
+    }
+
+    return 1;
+}
+
+void *secmem_alloc(size_t size)
+{
+    struct secmem_head *h;
+    size_t total = size + SECMEM_HEAD;
+    int cls = 0;
+
+    if(total < size) return NULL;
+
+    if(total > SECMEM_MAX_BLOCK)
+    {
+        size_t ps = page_size();
+        size_t mapped = (total + ps-1) / ps * ps;
+
+        if(mapped < total) return NULL;
+
+        LOCK();
+        h = (struct secmem_head *)pages_alloc(mapped);
+        UNLOCK();
+        if(h == NULL) return NULL;
+
+        h->size = mapped;
+        h->cls = -1;
+        return (char *)h + SECMEM_HEAD;
+    }
+
+    while(((size_t)1 << (SECMEM_MIN_SHIFT+cls)) < total) cls++;
+
+    LOCK();
+    if(free_list[cls] == NULL && !grow(cls))
+    {
+        UNLOCK();
+        return NULL;
+    }
+    h = free_list[cls];
+    free_list[cls] = NEXT(h);
+    UNLOCK();
+
+    NEXT(h) = NULL;
+    return (char *)h + SECMEM_HEAD;
+}
+
+void secmem_free(void *p)
+{
+    struct secmem_head *h;
+
+    if(p == NULL) return;
+
+    h = (struct secmem_head *)((char *)p - SECMEM_HEAD);
+    secmem_wipe(p, h->size - SECMEM_HEAD);
+
+    if(h->cls < 0)
+    {
+        pages_free(h, h->size);
+        return;
+    }
+
+    LOCK();
+    NEXT(h) = free_list[h->cls];
+    free_list[h->cls] = h;
+    UNLOCK();
+}
+
+int secmem_locked(void)
+{
+    return all_locked;
+}
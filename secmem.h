@@ -0,0 +1,53 @@
+/*
+ * Copyright 2010 (c) Sascha Mueller <mailbox@saschamueller.com>
+ *
+ * This file is part of qhashpw.
+ *
+ * qhashpw is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * qhashpw is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with qhashpw.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SECMEM_H
+#define SECMEM_H
+
+#include <stddef.h>
+
+/* Allocator for secrets (main password states, HMAC output, passwords).
+ * The memory comes from slabs of pages that are locked into RAM (so it
+ * is never swapped out) and left out of core dumps where the system
+ * allows that, and every block is wiped when it is freed. Small blocks
+ * are taken from slabs of a few fixed sizes, so creating a password
+ * does not touch the heap. Locking is best effort: if the limit for
+ * locked memory is reached, the pages are used unlocked. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* size bytes of zeroed memory, NULL if there is not enough memory */
+void *secmem_alloc(size_t size);
+
+/* Wipe and free p, which must come from secmem_alloc (or be NULL) */
+void secmem_free(void *p);
+
+/* Set size bytes at p to zero, without the compiler optimizing that
+ * away because the memory is not read anymore */
+void secmem_wipe(void *p, size_t size);
+
+/* Are all pages handed out so far locked into RAM? */
+int secmem_locked(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SECMEM_H
@@ -0,0 +1,286 @@
+/*
+ * Copyright 2010 (c) Sascha Mueller <mailbox@saschamueller.com>
+ *
+ * This file is part of qhashpw.
+ *
+ * qhashpw is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * qhashpw is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with qhashpw.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QEvent>
+#include <QtCore/QMutexLocker>
+
+#include "taskscheduler.h"
+
+// posted to the scheduler when the completion stack was empty
+static const QEvent::Type CompletionEvent = QEvent::Type(QEvent::User+1);
+
+CancelToken::CancelToken()
+: d_(new Data)
+{
+    d_->cancelled = 0;
+}
+
+ScheduledTask::ScheduledTask(const CancelToken &token)
+: token_(token), next_(0)
+{
+}
+
+ScheduledTask::~ScheduledTask()
+{
+}
+
+TaskScheduler::TaskScheduler(int threads, QObject *parent)
+: QObject(parent), nextQueue_(0), background_(0), idle_(0), stopping_(false), completed_(0)
+{
+    if(threads <= 0) threads = qMax(2, QThread::idealThreadCount());
+
+    maxBackground_ = qMax(1, threads-1);
+
+    for(int i = 0; i < threads; ++i)
+        queues_.append(new Queue);
+
+    for(int i = 0; i < threads; ++i)
+    {
+        workers_.append(new Worker(this, i));
+        workers_[i]->start();
+    }
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    {
+        QMutexLocker l(&idleLock_);
+        stopping_ = true;
+    }
+
+    // the queued tasks are dropped by the workers
+    foreach(Queue *q, queues_)
+    {
+        QMutexLocker l(&q->lock);
+        for(int p = 0; p < 2; ++p)
+            foreach(ScheduledTask *t, q->tasks[p])
+                t->token_.cancel();
+    }
+
+    {
+        QMutexLocker l(&idleLock_);
+        wake_.wakeAll();
+    }
+
+    foreach(Worker *w, workers_)
+    {
+        w->wait();
+        delete w;
+    }
+
+    // nobody is left to hear of these
+    ScheduledTask *t = completed_.fetchAndStoreAcquire(0);
+    while(t != 0)
+    {
+        ScheduledTask *next = t->next_;
+        delete t;
+        t = next;
+    }
+
+    qDeleteAll(queues_);
+}
+
+TaskScheduler *TaskScheduler::instance()
+{
+    static TaskScheduler *scheduler = 0;
+    if(scheduler == 0)
+        scheduler = new TaskScheduler(0, QCoreApplication::instance());
+    return scheduler;
+}
+
+void TaskScheduler::submit(ScheduledTask *task, Priority priority)
+{
+    task->state_.reportStarted();
+
+    int q = worker();
+    if(q == -1) q = unsigned(nextQueue_.fetchAndAddRelaxed(1)) % queues_.count();
+
+    {
+        QMutexLocker l(&queues_[q]->lock);
+        queues_[q]->tasks[priority].append(task);
+    }
+
+    // only now a worker may look for it
+    queued_[priority].ref();
+    wakeOne();
+}
+
+int TaskScheduler::worker() const
+{
+    for(int i = 0; i < workers_.count(); ++i)
+        if(workers_[i] == QThread::currentThread()) return i;
+    return -1;
+}
+
+bool TaskScheduler::hasWork() const
+{
+    return queued_[Interactive] > 0 ||
+           (queued_[Background] > 0 && background_ < maxBackground_);
+}
+
+void TaskScheduler::wakeOne()
+{
+    // under the lock, so a worker cannot miss it between its check of
+    // hasWork() and the wait
+    QMutexLocker l(&idleLock_);
+    if(idle_ > 0) wake_.wakeOne();
+}
+
+void TaskScheduler::work(int self)
+{
+    for(;;)
+    {
+        int priority;
+        ScheduledTask *t = find(self, &priority);
+
+        if(t != 0)
+        {
+            if(!t->token_.isCancelled()) t->run();
+            t->state_.reportFinished();
+            complete(t);
+
+            if(priority == Background)
+            {
+                // another worker may be waiting for the slot
+                background_.deref();
+                if(queued_[Background] > 0) wakeOne();
+            }
+            continue;
+        }
+
+        QMutexLocker l(&idleLock_);
+        ++idle_;
+        while(!hasWork())
+        {
+            if(stopping_ && queued_[Interactive] == 0 && queued_[Background] == 0)
+            {
+                --idle_;
+                return;
+            }
+            wake_.wait(&idleLock_);
+        }
+        --idle_;
+    }
+}
+
+ScheduledTask *TaskScheduler::find(int self, int *priority)
+{
+    ScheduledTask *t;
+
+    if(queued_[Interactive] > 0 && (t = take(self, Interactive)) != 0)
+    {
+        *priority = Interactive;
+        return t;
+    }
+
+    if(queued_[Background] > 0)
+    {
+        // reserve a slot first, so the last worker stays free
+        int running;
+        do
+        {
+            running = background_;
+            if(running >= maxBackground_) return 0;
+        }
+        while(!background_.testAndSetOrdered(running, running+1));
+
+        if((t = take(self, Background)) != 0)
+        {
+            *priority = Background;
+            return t;
+        }
+        background_.deref();
+    }
+
+    return 0;
+}
+
+ScheduledTask *TaskScheduler::take(int self, int priority)
+{
+    // the own queue from the front
+    {
+        Queue *q = queues_[self];
+        QMutexLocker l(&q->lock);
+        if(!q->tasks[priority].isEmpty())
+        {
+            queued_[priority].deref();
+            return q->tasks[priority].takeFirst();
+        }
+    }
+
+    // then steal from the back of the others
+    for(int i = 1; i < queues_.count(); ++i)
+    {
+        Queue *q = queues_[(self+i) % queues_.count()];
+        QMutexLocker l(&q->lock);
+        if(!q->tasks[priority].isEmpty())
+        {
+            queued_[priority].deref();
+            return q->tasks[priority].takeLast();
+        }
+    }
+
+    // another worker was faster
+    return 0;
+}
+
+void TaskScheduler::complete(ScheduledTask *task)
+{
+    ScheduledTask *head;
+    do
+    {
+        head = completed_;
+        task->next_ = head;
+    }
+    while(!completed_.testAndSetRelease(head, task));
+
+    // if it was not empty, an event is on its way already
+    if(head == 0)
+        QCoreApplication::postEvent(this, new QEvent(CompletionEvent));
+}
+
+bool TaskScheduler::event(QEvent *e)
+{
+    if(e->type() != CompletionEvent) return QObject::event(e);
+    deliver();
+    return true;
+}
+
+void TaskScheduler::deliver()
+{
+    // take the whole stack at once (so there is no ABA problem) and
+    // reverse it into the order the tasks finished in
+    ScheduledTask *t = completed_.fetchAndStoreAcquire(0), *order = 0;
+    while(t != 0)
+    {
+        ScheduledTask *next = t->next_;
+        t->next_ = order;
+        order = t;
+        t = next;
+    }
+
+    while(order != 0)
+    {
+        ScheduledTask *next = order->next_;
+        order->finished();
+        delete order;
+        order = next;
+    }
+}
@@ -0,0 +1,173 @@
+/*
+ * Copyright 2010 (c) Sascha Mueller <mailbox@saschamueller.com>
+ *
+ * This file is part of qhashpw.
+ *
+ * qhashpw is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * qhashpw is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with qhashpw.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TASKSCHEDULER_H
+#define TASKSCHEDULER_H
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QAtomicPointer>
+#include <QtCore/QFuture>
+#include <QtCore/QFutureInterface>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QObject>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QThread>
+#include <QtCore/QWaitCondition>
+
+class QEvent;
+
+// A flag that stops one or more tasks. Copies share the flag.
+class CancelToken
+{
+public:
+    CancelToken();
+
+    void cancel() { d_->cancelled = 1; }
+    bool isCancelled() const { return d_->cancelled != 0; }
+
+    // for functions like hashpw_job_run that check a flag themselves
+    const volatile int *flag() const { return &d_->cancelled; }
+
+private:
+    struct Data { volatile int cancelled; };
+    QSharedPointer<Data> d_;
+};
+
+// A unit of work for the TaskScheduler, which deletes it when it is done
+class ScheduledTask
+{
+public:
+    ScheduledTask(const CancelToken &token = CancelToken());
+    virtual ~ScheduledTask();
+
+    CancelToken token() const { return token_; }
+
+    // Finishes when run() has returned or the task was dropped because it
+    // was cancelled before it started, so another thread can wait for it
+    QFuture<void> future() const { return state_.future(); }
+
+protected:
+    // In a worker thread. Should check token() now and then.
+    virtual void run() = 0;
+
+    // In the thread of the scheduler (the GUI thread) after run(), or
+    // instead of it if the task was dropped
+    virtual void finished() {}
+
+private:
+    friend class TaskScheduler;
+
+    CancelToken token_;
+    mutable QFutureInterface<void> state_;
+    ScheduledTask *next_;           // in the completion queue
+};
+
+// The one thread pool for parsing, searching and creating passwords, so
+// they do not run more threads than there are cores when they are busy
+// at the same time. Every worker has a deque of its own with its own lock
+// (a task submitted by a worker goes there, the others are spread round
+// robin). The worker takes the oldest task from the front of it, and
+// only when it is empty steals the newest task from the back of another
+// deque. So the tasks of one deque start in the order they were
+// submitted, but there is no order across the deques. A worker that
+// finds nothing sleeps on a wait condition of its own, the deques are
+// not locked for that. Interactive tasks (something the user waits for)
+// are always taken first, and background tasks never occupy the last
+// worker, so an interactive task starts right away.
+class TaskScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Priority { Interactive, Background };
+
+    // threads <= 0: one per core, but at least 2
+    TaskScheduler(int threads = 0, QObject *parent = 0);
+    ~TaskScheduler();   // cancels the tasks that did not start and waits for the others
+
+    // The scheduler of the application, created on first use
+    // (must be called from the GUI thread first)
+    static TaskScheduler *instance();
+
+    // Queue task, which is deleted after its finished(). May be called
+    // from any thread, a worker puts the task into its own queue.
+    void submit(ScheduledTask *task, Priority priority);
+
+    int threadCount() const { return workers_.count(); }
+
+    // Whether the calling thread is one of the workers, which must not
+    // wait for other tasks (they might never start)
+    bool isWorker() const { return worker() != -1; }
+
+protected:
+    bool event(QEvent *e);
+
+private:
+    class Worker : public QThread
+    {
+    public:
+        Worker(TaskScheduler *s, int self) : scheduler_(s), self_(self) {}
+    protected:
+        void run() { scheduler_->work(self_); }
+    private:
+        TaskScheduler *scheduler_;
+        int self_;
+    };
+
+    struct Queue
+    {
+        QMutex lock;
+        QList<ScheduledTask *> tasks[2];    // by priority
+    };
+
+    int worker() const;             // of the calling thread, or -1
+    void work(int self);
+    ScheduledTask *find(int self, int *priority);
+    ScheduledTask *take(int self, int priority);
+    bool hasWork() const;
+    void wakeOne();
+    void complete(ScheduledTask *task);
+    void deliver();
+
+    QList<Worker *> workers_;
+    QList<Queue *> queues_;         // one per worker
+    QAtomicInt nextQueue_;          // round robin for the other threads
+
+    // Tasks in all queues by priority (counted after a task is put into
+    // its queue and when it is taken out) and the background tasks that
+    // run. A worker reserves a background slot before it looks for one.
+    QAtomicInt queued_[2];
+    QAtomicInt background_;
+    int maxBackground_;
+
+    // The idle workers wait here until hasWork(); idle_ and stopping_
+    // are guarded by idleLock_
+    QMutex idleLock_;
+    QWaitCondition wake_;
+    int idle_;
+    bool stopping_;
+
+    // finished tasks on their way to the GUI thread, a lock-free stack
+    QAtomicPointer<ScheduledTask> completed_;
+
+    Q_DISABLE_COPY(TaskScheduler)
+};
+
+#endif // TASKSCHEDULER_H
@@ -18,11 +18,15 @@
  */
 
 #include <cctype>
+#include <climits>
+#include <cstring>
 
 #include "tokenizer.h"
+#include "tokscan.h"
 
 Tokenizer::Tokenizer(QFile *f)
-: error_(NO_ERROR), f_(NULL), lineno_(1), tokT_(TT_NOTHING)
+: error_(NO_ERROR), f_(NULL), lineno_(1), tokT_(TT_NOTHING), map_(0), p_(0), end_(0),
+  text_(false), pushback_(0), hasPushback_(false), tokBegin_(0), tokLen_(0), arenaLen_(0)
 {
     if(!f->isReadable())
     {
@@ -31,14 +35,100 @@ Tokenizer::Tokenizer(QFile *f)
     }
 
     f_ = f;
+    text_ = (f->openMode() & QIODevice::Text) != 0;
 
+    // One linear pass over memory instead of a virtual call per character
+    qint64 size = f->size() - f->pos();
+    if(!f->isSequential() && size > 0 && size <= INT_MAX)
+        map_ = f->map(f->pos(), size);
+
+    if(map_ != 0)
+    {
+        p_ = reinterpret_cast<const char *>(map_);
+        end_ = p_ + size;
+    }
+     else
+    {
+        data_ = f->readAll();   // already without '\r' in text mode
+        p_ = data_.constData();
+        end_ = p_ + data_.size();
+    }
+
+    next();
+}
+
+Tokenizer::Tokenizer(const Tokenizer *whole, const char *begin, const char *end, int lineno)
+: error_(NO_ERROR), f_(whole->f_), lineno_(lineno), tokT_(TT_NOTHING), map_(0), p_(begin), end_(end),
+  text_(whole->text_), pushback_(0), hasPushback_(false), tokBegin_(0), tokLen_(0), arenaLen_(0)
+{
     next();
 }
 
 Tokenizer::~Tokenizer()
 {
-    if(tokT_ == TT_STRING || tokT_ == TT_COMMENT)
-        delete tok.s;
+    if(map_ != 0) f_->unmap(map_);
+}
+
+bool Tokenizer::getChar(char *c)
+{
+    if(hasPushback_)
+    {
+        *c = pushback_;
+        hasPushback_ = false;
+        return true;
+    }
+
+    while(p_ < end_)
+    {
+        char ch = *p_++;
+        if(ch != '\r' || !text_)
+        {
+            *c = ch;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void Tokenizer::arenaAppend(char c)
+{
+    if(arenaLen_ == arena_.size())
+        arena_.resize(qMax(64, 2*arena_.size()));
+    arena_.data()[arenaLen_++] = c;
+}
+
+QString Tokenizer::tokString() const
+{
+    if(tokT_ != TT_STRING && tokT_ != TT_COMMENT) return QString();
+
+    // quoted strings may be empty, but never null
+    if(tokLen_ == 0) return QString("");
+
+    if(text_ && std::memchr(tokBegin_, '\r', tokLen_) != 0)
+    {
+        QByteArray b(tokBegin_, tokLen_);
+        b.replace("\r", "");
+        return QString::fromLatin1(b.constData(), b.size());
+    }
+
+    return QString::fromLatin1(tokBegin_, tokLen_);
+}
+
+int Tokenizer::tokCopy(char *buf, int size) const
+{
+    if(tokT_ != TT_STRING) return -1;
+
+    const char *p = tokBegin_, *end = tokBegin_ + tokLen_;
+    int len = 0;
+    for(; p < end; ++p)
+    {
+        if(*p == '\r' && text_) continue;
+        if(len + 1 >= size) return -1;
+        buf[len++] = *p;
+    }
+    buf[len] = 0;
+    return len;
 }
 
 QString Tokenizer::currentTokenDesc() const
@@ -48,7 +138,7 @@ QString Tokenizer::currentTokenDesc() const
       case TT_NOTHING:
         return tr("<nothing>");
       case TT_STRING:
-        return tr("<string, \"%1\">").arg(*tok.s);
+        return tr("<string, \"%1\">").arg(tokString());
       case TT_NUMBER:
         return tr("<number, %1>").arg(tok.i);
       case TT_CHAR:
@@ -57,7 +147,7 @@ QString Tokenizer::currentTokenDesc() const
                 (isspace(tok.c)?
                  ' ':tok.c):'.');
       case TT_COMMENT:
-        return tr("<comment, \"%1\">").arg(*tok.s);
+        return tr("<comment, \"%1\">").arg(tokString());
     }
 }
 
@@ -72,34 +162,44 @@ bool Tokenizer::next(bool commentIsToken)
     bool incomment = false;    // Are we in a comment?
     const int MAXBUF = 2<<20;  // Maximum buffer size. A megabyte string is probably not useful
 
-    QString buffer;
-
-    // De-initialize the old token
-    if(tokT_ == TT_STRING || tokT_ == TT_COMMENT) delete tok.s;
-
     tokT_ = TT_NOTHING;
 
+    // The skipped text is only needed for comment tokens
+    arenaLen_ = 0;
+
     // Skip all whitespace and comments (if required)
-    do if(!f_->getChar(&c)) c = 0;
-      else if(c == '\n')
-      {
-          lineno_++;
-          if(incomment && commentIsToken)
-          {
-              tokT_ = TT_COMMENT;
-              tok.s = new QString(buffer);
-              return true;
-          }
-          incomment = false;
-      }
-      else
-      {
-          buffer += c;
-          if(c == '#') incomment = true;
-      }
-    while(!f_->atEnd() && (incomment || isspace(c)));
-
-    if(f_->atEnd())
+    do
+    {
+        if(!getChar(&c)) c = 0;
+        else if(c == '\n')
+        {
+            lineno_++;
+            if(incomment && commentIsToken)
+            {
+                tokT_ = TT_COMMENT;
+                tokBegin_ = arena_.constData();
+                tokLen_ = arenaLen_;
+                return true;
+            }
+            incomment = false;
+        }
+        else
+        {
+            if(commentIsToken) arenaAppend(c);
+            if(c == '#') incomment = true;
+        }
+
+        // Skip the rest of the comment or whitespace at once, up to
+        // the '\n' resp. the first byte that may not be whitespace
+        if(!commentIsToken)
+        {
+            if(incomment) p_ += tokscan_line(p_, end_-p_);
+            else if(isspace(c)) p_ += tokscan_space(p_, end_-p_, &lineno_);
+        }
+    }
+    while(!atEnd() && (incomment || isspace(c)));
+
+    if(atEnd())
     {
         error_ = EOF_ERROR;
         return false;
@@ -117,9 +217,11 @@ bool Tokenizer::next(bool commentIsToken)
 
     // Parse whatever comes now as a string (either quoted or unquoted)
     int isNumber = isdigit(c);     // is it a number?
+    int length = 0;                // characters of the string
 
-    tok.s = new QString("");
     tokT_ = TT_STRING;
+    tokBegin_ = p_;
+    tokLen_ = 0;
 
     do
     {
@@ -129,40 +231,124 @@ bool Tokenizer::next(bool commentIsToken)
         if(isQuoted && c == '"') goto skipCharacter;
 
         // See if there is still room in the string buffer
-        if(tok.s->length() >= MAXBUF)
+        if(length >= MAXBUF)
         {
             error_ = BUF_OVERRUN_ERROR;
-            delete tok.s;
             tokT_ = TT_NOTHING;
             return false;
         }
 
-        // Add the current character to the string buffer
-        *tok.s += c;
+        // The string is the part of the contents up to the current
+        // character, which was read from there (a character that was
+        // put back is never part of a string)
+        if(length++ == 0) tokBegin_ = p_-1;
+        tokLen_ = p_ - tokBegin_;
 
         // Quoted strings may contain newlines
         if(c == '\n') lineno_++;
 
+        // Take the rest of the run at once, but never the last byte
+        // of the contents (see the loop condition) and not more than
+        // fits into the buffer
+        if(end_-p_ > 1)
+        {
+            size_t n = qMin(size_t(end_-p_-1), size_t(MAXBUF-length));
+            n = isQuoted ? tokscan_quoted(p_, n, &lineno_) : tokscan_alnum(p_, n);
+            p_ += n;
+            length += n;
+            tokLen_ = p_ - tokBegin_;
+        }
+
     skipCharacter:
         char tmp;
-        c = f_->getChar(&tmp) ? tmp : 0;
-    } while(!f_->atEnd() && ((isQuoted && c != '"') || isalnum(c)));
+        c = getChar(&tmp) ? tmp : 0;
+    } while(!atEnd() && ((isQuoted && c != '"') || isalnum(c)));
 
     // if we did not read a quoted string, we have read one
     // character too much
-    if(!isQuoted) f_->ungetChar(c);
+    if(!isQuoted) ungetChar(c);
 
     if(isNumber)
     {
-        int i = tok.s->toInt();
-        delete tok.s;
+        // the same as QString::toInt(): 0 unless the whole
+        // string is a number that fits
+        long long i = 0;
+        for(int j = 0; j < tokLen_ && i <= INT_MAX; ++j)
+        {
+            if(tokBegin_[j] == '\r' && text_) continue;
+            if(!isdigit(tokBegin_[j])) { i = 0; break; }
+            i = i*10 + (tokBegin_[j]-'0');
+        }
+
         tokT_ = TT_NUMBER;
-        tok.i = i;
+        tok.i = i > INT_MAX ? 0 : int(i);
     }
 
     return true;
 }
 
+QList<Tokenizer *> Tokenizer::split(int pieceSize)
+{
+    QList<Tokenizer *> pieces;
+
+    // A character that was put back is not in the contents anymore
+    if(hasPushback_ || p_ >= end_) return pieces;
+
+    int depth;                  // of '{' brackets
+    if(tokT_ == TT_CHAR && tok.c == '{')
+        depth = 1;
+    else if(tokT_ == TT_COMMENT)
+        depth = 0;
+    else
+        return pieces;
+
+    const char *p = p_, *end = end_, *begin = 0;
+    int line = lineno_, beginLine = 0;
+
+    while(p < end)
+    {
+        switch(*p++)
+        {
+          case '\n':
+            line++;
+            break;
+          case '#':
+            // the '\n' is counted above
+            p += tokscan_line(p, end-p);
+            break;
+          case '"':
+            // an unquoted string ends at the '"', so it always starts
+            // a quoted string (which may contain everything but '"')
+            while(p < end && *p != '"')
+            {
+                p += tokscan_quoted(p, end-p, &line);
+                if(p < end && *p == '\r') p++;
+            }
+            if(p < end) p++;
+            break;
+          case '}':
+            depth--;
+            break;
+          case '{':
+            if(depth++ == 0 && p-1 - (begin ? begin : p_) >= pieceSize && p[-2] == '\n')
+            {
+                if(begin != 0)
+                    pieces.append(new Tokenizer(this, begin, p-1, beginLine));
+                else
+                    end_ = p-1;
+                begin = p-1;
+                beginLine = line;
+            }
+            break;
+        }
+    }
+
+    if(begin != 0)
+        pieces.append(new Tokenizer(this, begin, end, beginLine));
+
+    return pieces;
+}
+
 bool Tokenizer::forceCharToken(char c, bool commentIsToken)
 {
     if(tokT_ == TT_CHAR && tok.c == c)
@@ -20,7 +20,9 @@
 #ifndef TOKENIZER_H
 #define TOKENIZER_H
 
+#include <QByteArray>
 #include <QFile>
+#include <QList>
 #include <QString>
 
 class Tokenizer: public QObject
@@ -48,19 +50,30 @@ public:
 
     union {
         int i;
-        QString *s;
         char c;
     } tok;
 
+    // The current TT_STRING or TT_COMMENT token (a null string for the
+    // other types). The tokens are kept as views into the file contents,
+    // this converts one (on every call).
+    QString tokString() const;
+
+    // Copy the current TT_STRING token into buf (zero terminated, no
+    // conversion) and return its length, or -1 if the current token is
+    // not a string or it does not fit into size bytes
+    int tokCopy(char *buf, int size) const;
+
     const QString filename() const;
 
     // Line number of the current token
     inline int lineno() const { return lineno_; }
 
-    // Initializes tokenizer with the given file
+    // Initializes tokenizer with the given file, which must stay open
+    // while the tokenizer exists. A regular file is mapped into memory,
+    // anything else (e.g. a pipe) is read at once.
     Tokenizer(QFile *filename);
 
-    // Closes the file and cleans up
+    // Unmaps the file and cleans up
     ~Tokenizer();
 
     // Advance to the next token
@@ -73,11 +86,52 @@ public:
     // Print a short description about the current token
     QString currentTokenDesc() const;
 
+    // Number of bytes that were not read yet
+    inline int bytesLeft() const { return end_ - p_; }
+
+    // Between two assignment blocks (the current token is a '{' or a
+    // comment), cut the rest of the contents into pieces of at least
+    // pieceSize bytes, which can be read at the same time. A piece ends
+    // before a '{' at the start of a line that is not inside a block,
+    // a quoted string or a comment, so every piece gives the same tokens
+    // (and line numbers) as this tokenizer would. This tokenizer keeps
+    // the first piece and reaches EOF at its end, the tokenizers of the
+    // others are returned in order (they have to be deleted before this
+    // one). Returns an empty list if nothing was cut.
+    QList<Tokenizer *> split(int pieceSize);
+
 private:
+    // A piece of whole (see split), starting at line lineno
+    Tokenizer(const Tokenizer *whole, const char *begin, const char *end, int lineno);
+
+    // The same as QFile::getChar(), ungetChar() and atEnd() (in text mode
+    // without '\r' like QFile) on the contents
+    inline bool getChar(char *c);
+    inline void ungetChar(char c) { pushback_ = c; hasPushback_ = true; }
+    inline bool atEnd() const { return !hasPushback_ && p_ >= end_; }
+
     Error error_;
     QFile *f_;
     int lineno_;
     Type tokT_;
+
+    uchar *map_;                // the mapped file or 0
+    QByteArray data_;           // the contents if the file could not be mapped
+    const char *p_, *end_;      // the unread part of the contents
+    bool text_;                 // drop '\r'
+    char pushback_;
+    bool hasPushback_;
+
+    // the current string or comment token: tokLen_ bytes from tokBegin_,
+    // which may contain '\r' in text mode
+    const char *tokBegin_;
+    int tokLen_;
+
+    // Comments are collected (they are not in one piece) in arenaLen_
+    // bytes of arena_, which is reused for every token
+    void arenaAppend(char c);
+    QByteArray arena_;
+    int arenaLen_;
 };
 
 #endif // TOKENIZER_H
@@ -0,0 +1,313 @@
+/*
+ * Copyright 2010 (c) Sascha Mueller <mailbox@saschamueller.com>
+ *
+ * This file is part of qhashpw.
+ *
+ * qhashpw is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * qhashpw is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with qhashpw.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "tokscan.h"
+
+struct tokscan_kernel
+{
+    const char *name;
+    size_t (*alnum)(const char *p, size_t n);
+    size_t (*space)(const char *p, size_t n, int *newlines);
+    size_t (*quoted)(const char *p, size_t n, int *newlines);
+};
+
+/*******************************************************************/
+/** Scalar kernel                                                 **/
+
+#define IS_ALNUM(c)     (((c) >= '0' && (c) <= '9') || \
+                         (((c)|0x20) >= 'a' && ((c)|0x20) <= 'z'))
+#define IS_SPACE(c)     ((c) == ' ' || ((c) >= '\t' && (c) <= '\r'))
+
+static size_t alnum_scalar(const char *p, size_t n)
+{
+    const unsigned char *s = (const unsigned char *)p;
+    size_t i = 0;
+
+    while(i < n && IS_ALNUM(s[i])) ++i;
+    return i;
+}
+
+static size_t space_scalar(const char *p, size_t n, int *newlines)
+{
+    const unsigned char *s = (const unsigned char *)p;
+    size_t i = 0;
+
+    for(; i < n && IS_SPACE(s[i]); ++i)
+        if(s[i] == '\n') ++*newlines;
+    return i;
+}
+
+static size_t quoted_scalar(const char *p, size_t n, int *newlines)
+{
+    size_t i = 0;
+
+    for(; i < n && p[i] != '"' && p[i] != '\r'; ++i)
+        if(p[i] == '\n') ++*newlines;
+    return i;
+}
+
+static const struct tokscan_kernel kernel_scalar =
+{
+    "scalar", alnum_scalar, space_scalar, quoted_scalar
+};
+
+/*******************************************************************/
+/** SIMD kernels                                                  **/
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TOKSCAN_X86
+
+#include <immintrin.h>
+
+/* Every kernel computes, for a block of bytes, a bit mask of the bytes
+ * that end the run (the first set bit is the end) and one of the '\n'.
+ * A byte is in [lo, hi] if (byte - lo) mod 256 < hi-lo+1, which is a
+ * signed compare after moving lo to -128. */
+
+#define SSE2_ATTR       __attribute__((target("sse2")))
+
+static inline SSE2_ATTR __m128i in_range_sse2(__m128i v, char lo, char hi)
+{
+    __m128i t = _mm_add_epi8(v, _mm_set1_epi8((char)(0x80 - lo)));
+    return _mm_cmplt_epi8(t, _mm_set1_epi8((char)(-128 + (hi - lo) + 1)));
+}
+
+static inline SSE2_ATTR unsigned alnum_mask_sse2(__m128i v)
+{
+    __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    __m128i ok = _mm_or_si128(in_range_sse2(v, '0', '9'), in_range_sse2(lower, 'a', 'z'));
+    return ~(unsigned)_mm_movemask_epi8(ok) & 0xffff;
+}
+
+static inline SSE2_ATTR unsigned space_mask_sse2(__m128i v)
+{
+    __m128i ok = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                              in_range_sse2(v, '\t', '\r'));
+    return ~(unsigned)_mm_movemask_epi8(ok) & 0xffff;
+}
+
+static inline SSE2_ATTR unsigned quoted_mask_sse2(__m128i v)
+{
+    return _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')),
+                                          _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+}
+
+static inline SSE2_ATTR unsigned newline_mask_sse2(__m128i v)
+{
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+}
+
+/* The '\n' before the end of the run, i.e. below the lowest bit of stop */
+#define COUNT_NEWLINES(nl, stop) \
+    __builtin_popcount((stop) ? (nl) & (((stop) & -(stop))-1) : (nl))
+
+static SSE2_ATTR size_t alnum_sse2(const char *p, size_t n)
+{
+    size_t i = 0;
+    for(; i+16 <= n; i += 16)
+    {
+        unsigned stop = alnum_mask_sse2(_mm_loadu_si128((const __m128i *)(p+i)));
+        if(stop) return i + __builtin_ctz(stop);
+    }
+    return i + alnum_scalar(p+i, n-i);
+}
+
+static SSE2_ATTR size_t space_sse2(const char *p, size_t n, int *newlines)
+{
+    size_t i = 0;
+    for(; i+16 <= n; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p+i));
+        unsigned stop = space_mask_sse2(v);
+        *newlines += COUNT_NEWLINES(newline_mask_sse2(v), stop);
+        if(stop) return i + __builtin_ctz(stop);
+    }
+    return i + space_scalar(p+i, n-i, newlines);
+}
+
+static SSE2_ATTR size_t quoted_sse2(const char *p, size_t n, int *newlines)
+{
+    size_t i = 0;
+    for(; i+16 <= n; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p+i));
+        unsigned stop = quoted_mask_sse2(v);
+        *newlines += COUNT_NEWLINES(newline_mask_sse2(v), stop);
+        if(stop) return i + __builtin_ctz(stop);
+    }
+    return i + quoted_scalar(p+i, n-i, newlines);
+}
+
+#define AVX2_ATTR       __attribute__((target("avx2")))
+
+static inline AVX2_ATTR __m256i in_range_avx2(__m256i v, char lo, char hi)
+{
+    __m256i t = _mm256_add_epi8(v, _mm256_set1_epi8((char)(0x80 - lo)));
+    return _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(-128 + (hi - lo) + 1)), t);
+}
+
+static inline AVX2_ATTR unsigned alnum_mask_avx2(__m256i v)
+{
+    __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    __m256i ok = _mm256_or_si256(in_range_avx2(v, '0', '9'), in_range_avx2(lower, 'a', 'z'));
+    return ~(unsigned)_mm256_movemask_epi8(ok);
+}
+
+static inline AVX2_ATTR unsigned space_mask_avx2(__m256i v)
+{
+    __m256i ok = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                                 in_range_avx2(v, '\t', '\r'));
+    return ~(unsigned)_mm256_movemask_epi8(ok);
+}
+
+static inline AVX2_ATTR unsigned quoted_mask_avx2(__m256i v)
+{
+    return _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')),
+                                                _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))));
+}
+
+static inline AVX2_ATTR unsigned newline_mask_avx2(__m256i v)
+{
+    return _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+}
+
+static AVX2_ATTR size_t alnum_avx2(const char *p, size_t n)
+{
+    size_t i = 0;
+    for(; i+32 <= n; i += 32)
+    {
+        unsigned stop = alnum_mask_avx2(_mm256_loadu_si256((const __m256i *)(p+i)));
+        if(stop) return i + __builtin_ctz(stop);
+    }
+    return i + alnum_sse2(p+i, n-i);
+}
+
+static AVX2_ATTR size_t space_avx2(const char *p, size_t n, int *newlines)
+{
+    size_t i = 0;
+    for(; i+32 <= n; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(p+i));
+        unsigned stop = space_mask_avx2(v);
+        *newlines += COUNT_NEWLINES(newline_mask_avx2(v), stop);
+        if(stop) return i + __builtin_ctz(stop);
+    }
+    return i + space_sse2(p+i, n-i, newlines);
+}
+
+static AVX2_ATTR size_t quoted_avx2(const char *p, size_t n, int *newlines)
+{
+    size_t i = 0;
+    for(; i+32 <= n; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(p+i));
+        unsigned stop = quoted_mask_avx2(v);
+        *newlines += COUNT_NEWLINES(newline_mask_avx2(v), stop);
+        if(stop) return i + __builtin_ctz(stop);
+    }
+    return i + quoted_sse2(p+i, n-i, newlines);
+}
+
+static const struct tokscan_kernel kernel_sse2 =
+{
+    "sse2", alnum_sse2, space_sse2, quoted_sse2
+};
+
+static const struct tokscan_kernel kernel_avx2 =
+{
+    "avx2", alnum_avx2, space_avx2, quoted_avx2
+};
+
+#endif
+
+/* Best kernel first */
+static const struct tokscan_kernel *available_kernel(int i)
+{
+#ifdef TOKSCAN_X86
+    __builtin_cpu_init();
+
+    switch(i)
+    {
+    case 0: return __builtin_cpu_supports("avx2") ? &kernel_avx2 : NULL;
+    case 1: return __builtin_cpu_supports("sse2") ? &kernel_sse2 : NULL;
+    case 2: return &kernel_scalar;
+    default: return NULL;
+    }
+#else
+    return i == 0 ? &kernel_scalar : NULL;
+#endif
+}
+
+#define MAX_KERNELS     3
+
+/* The kernel in use. Selecting the best one twice concurrently
+ * stores the same pointer, so no locking is done here */
+static const struct tokscan_kernel *current = NULL;
+
+static const struct tokscan_kernel *kernel(void)
+{
+    if(current == NULL) tokscan_select(NULL);
+    return current;
+}
+
+int tokscan_select(const char *name)
+{
+    int i;
+
+    for(i = 0; i < MAX_KERNELS; ++i)
+    {
+        const struct tokscan_kernel *k = available_kernel(i);
+        if(k != NULL && (name == NULL || strcmp(name, k->name) == 0))
+        {
+            current = k;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+const char *tokscan_kernel(void)
+{
+    return kernel()->name;
+}
+
+size_t tokscan_alnum(const char *p, size_t n)
+{
+    return kernel()->alnum(p, n);
+}
+
+size_t tokscan_space(const char *p, size_t n, int *newlines)
+{
+    return kernel()->space(p, n, newlines);
+}
+
+size_t tokscan_quoted(const char *p, size_t n, int *newlines)
+{
+    return kernel()->quoted(p, n, newlines);
+}
+
+size_t tokscan_line(const char *p, size_t n)
+{
+    /* the C library has the fastest search for a single byte */
+    const char *nl = (const char *)memchr(p, '\n', n);
+    return nl ? (size_t)(nl - p) : n;
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright 2010 (c) Sascha Mueller <mailbox@saschamueller.com>
+ *
+ * This file is part of qhashpw.
+ *
+ * qhashpw is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * qhashpw is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with qhashpw.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TOKSCAN_H
+#define TOKSCAN_H
+
+#include <stddef.h>
+
+/* Scanners for the tokenizer that look at 16 (SSE2) or 32 (AVX2) bytes
+ * at a time. The kernel is chosen at runtime from what the CPU supports;
+ * "scalar" works everywhere. They only know ASCII: every byte of 0x80 and
+ * above ends a run, so the tokenizer decides on those with the locale
+ * (isspace, isalnum) like before. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Length of the run of [0-9A-Za-z] at the start of the n bytes at p */
+size_t tokscan_alnum(const char *p, size_t n);
+
+/* Length of the run of whitespace (' ', '\t', '\n', '\v', '\f', '\r'),
+ * the number of '\n' in it is added to *newlines */
+size_t tokscan_space(const char *p, size_t n, int *newlines);
+
+/* Length of the run of anything but '"' and '\r' (the contents of a
+ * quoted string), the number of '\n' in it is added to *newlines */
+size_t tokscan_quoted(const char *p, size_t n, int *newlines);
+
+/* Length of the run of anything but '\n' (the rest of a comment) */
+size_t tokscan_line(const char *p, size_t n);
+
+/* Name of the kernel in use */
+const char *tokscan_kernel(void);
+
+/* Use the kernel with the given name ("scalar", "sse2", "avx2")
+ * or the best available one if name is NULL.
+ * Returns 0 if that kernel is not available on this machine/build. */
+int tokscan_select(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TOKSCAN_H
@@ -0,0 +1,122 @@
+/*
+ * Copyright 2010 (c) Sascha Mueller <mailbox@saschamueller.com>
+ *
+ * This file is part of qhashpw.
+ *
+ * qhashpw is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * qhashpw is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with qhashpw.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtCore/QByteArray>
+#include <QtCore/QHash>
+#include <QtCore/QMap>
+#include <QtCore/QStringList>
+
+#include "vaultaudit.h"
+
+VaultAudit::VaultAudit(const AccountSet *as)
+: batch_(as), failed_(0)
+{
+}
+
+// Everything that goes into the password of opt but the main password
+static QByteArray inputKey(const PasswordOptions &opt)
+{
+    QByteArray k;
+    k.append(opt.salt).append('\0').append(opt.descr).append('\0');
+    k.append(QByteArray::number(opt.num)).append(',')
+     .append(QByteArray::number(opt.min)).append(',')
+     .append(QByteArray::number(opt.max)).append(',')
+     .append(QByteArray::number(opt.flags)).append(',')
+     .append(QByteArray::number(opt.hash)).append(',')
+     .append(QByteArray::number(opt.scheme));
+    return k;
+}
+
+// The groups of more than one entry, in order of their first entry
+static QList<QList<int> > groups(const QHash<QByteArray, QList<int> > &h)
+{
+    QMap<int, QList<int> > ordered;
+    QHash<QByteArray, QList<int> >::const_iterator it;
+
+    for(it = h.constBegin(); it != h.constEnd(); ++it)
+        if(it.value().count() > 1) ordered.insert(it.value().first(), it.value());
+
+    return ordered.values();
+}
+
+void VaultAudit::run(const struct hashpw_key *key, int threads)
+{
+    // This is the expensive part, the grouping below takes
+    // milliseconds even for tens of thousands of accounts
+    failed_ = batch_.generate(key, threads);
+
+    QHash<QByteArray, QList<int> > byInput, byPassword;
+    byInput.reserve(count());
+    byPassword.reserve(count());
+
+    for(int i = 0; i < count(); ++i)
+    {
+        if(batch_.status(i) != 0) continue;
+
+        QByteArray in = inputKey(batch_.options(i));
+        byInput[in].append(i);
+
+        // an empty password (max == 0) is no reuse
+        if(batch_.options(i).max > 0)
+            byPassword[batch_.passwordDigest(i)].append(i);
+    }
+
+    sameInput_ = groups(byInput);
+
+    // only the passwords that are shared by different inputs
+    samePassword_.clear();
+    foreach(const QList<int> &g, groups(byPassword))
+    {
+        QByteArray first = inputKey(batch_.options(g.first()));
+        foreach(int i, g)
+            if(inputKey(batch_.options(i)) != first)
+            {
+                samePassword_.append(g);
+                break;
+            }
+    }
+}
+
+QString VaultAudit::describe(const QList<int> &group) const
+{
+    QStringList names;
+    foreach(int i, group)
+        names << QString("%1@%2").arg(account(i).user()).arg(account(i).site());
+    return names.join(", ");
+}
+
+QString VaultAudit::report(int n) const
+{
+    QString report = tr("%1 accounts, %2 groups with the same input, "
+                        "%3 groups with different input but the same password\n")
+                     .arg(count())
+                     .arg(sameInput_.count())
+                     .arg(samePassword_.count());
+
+    if(failed_)
+        report += tr("%1 passwords could not be created\n").arg(failed_);
+
+    for(int i = 0; i < qMin(n, sameInput_.count()); ++i)
+        report += tr("\nSame input: %1").arg(describe(sameInput_[i]));
+
+    for(int i = 0; i < qMin(n, samePassword_.count()); ++i)
+        report += tr("\nSame password: %1").arg(describe(samePassword_[i]));
+
+    return report;
+}
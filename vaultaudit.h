@@ -0,0 +1,76 @@
+/*
+ * Copyright 2010 (c) Sascha Mueller <mailbox@saschamueller.com>
+ *
+ * This file is part of qhashpw.
+ *
+ * qhashpw is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * qhashpw is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with qhashpw.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef VAULTAUDIT_H
+#define VAULTAUDIT_H
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QList>
+#include <QtCore/QString>
+
+#include "passwordbatch.h"
+
+class AccountSet;
+struct hashpw_key;
+
+// Looks for accounts of a set that get the same password. The passwords
+// are created in parallel with PasswordBatch; only their digests are
+// compared.
+class VaultAudit
+{
+    Q_DECLARE_TR_FUNCTIONS(VaultAudit)
+
+public:
+    // Takes the resolved accounts of the current filter of as
+    VaultAudit(const AccountSet *as);
+
+    inline int count() const { return batch_.count(); }
+    inline const Account &account(int i) const { return batch_.account(i); }
+
+    // Create all passwords, using threads threads (<= 0: one per CPU),
+    // and group the accounts
+    void run(const struct hashpw_key *key, int threads = 0);
+
+    // Groups of accounts with identical input (salt, site+user, num,
+    // lengths, flags, algorithm and scheme), which always get the same
+    // password. Note that site "ab" with user "c" is the same input as
+    // site "a" with user "bc".
+    inline const QList<QList<int> > &sameInput() const { return sameInput_; }
+
+    // Groups of accounts with different input but the same password.
+    // Each group has at least two different inputs; accounts with the
+    // same input as another one of the group are included.
+    inline const QList<QList<int> > &samePassword() const { return samePassword_; }
+
+    // Number of accounts whose password could not be created
+    inline int failed() const { return failed_; }
+
+    // Human readable report on the (at most n) groups of each kind
+    QString report(int n = 20) const;
+
+private:
+    QString describe(const QList<int> &group) const;
+
+    PasswordBatch batch_;
+    QList<QList<int> > sameInput_;
+    QList<QList<int> > samePassword_;
+    int failed_;
+};
+
+#endif // VAULTAUDIT_H